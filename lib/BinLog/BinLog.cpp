@@ -0,0 +1,87 @@
+#include "BinLog.h"
+
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE binlogMux = portMUX_INITIALIZER_UNLOCKED;
+#define BINLOG_LOCK()   portENTER_CRITICAL_SAFE(&binlogMux)
+#define BINLOG_UNLOCK() portEXIT_CRITICAL_SAFE(&binlogMux)
+#else
+#include <atomic>
+#include <time.h>
+static std::atomic_flag binlogLock = ATOMIC_FLAG_INIT;
+#define BINLOG_LOCK()   while (binlogLock.test_and_set(std::memory_order_acquire)) {}
+#define BINLOG_UNLOCK() binlogLock.clear(std::memory_order_release)
+#endif
+
+static_assert((BINLOG_CAPACITY & (BINLOG_CAPACITY - 1)) == 0, "BINLOG_CAPACITY must be a power of two");
+
+BinLog binlog;
+
+uint32_t BinLog::nowUs() {
+#ifdef ARDUINO
+  return micros();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+#endif
+}
+
+void BinLog::write(uint8_t level, uint16_t id, uint8_t nargs, int32_t a0, int32_t a1, int32_t a2) {
+  uint32_t ts = nowUs();
+  BINLOG_LOCK();
+  if (head_ - tail_ >= BINLOG_CAPACITY) {
+    dropped_ = dropped_ + 1;
+    BINLOG_UNLOCK();
+    return;
+  }
+  LogRecord &r = ring_[head_ & (BINLOG_CAPACITY - 1)];
+  r.tsUs = ts;
+  r.id = id;
+  r.level = level;
+  r.nargs = nargs;
+  r.args[0] = a0;
+  r.args[1] = a1;
+  r.args[2] = a2;
+  head_ = head_ + 1;
+  written_ = written_ + 1;
+  BINLOG_UNLOCK();
+}
+
+bool BinLog::pop(LogRecord &rec) {
+  BINLOG_LOCK();
+  if (tail_ == head_) {
+    BINLOG_UNLOCK();
+    return false;
+  }
+  rec = ring_[tail_ & (BINLOG_CAPACITY - 1)];
+  tail_ = tail_ + 1;
+  BINLOG_UNLOCK();
+  return true;
+}
+
+uint16_t BinLog::pending() const {
+  return (uint16_t)(head_ - tail_);
+}
+
+size_t BinLog::format(const LogRecord &rec, const char *const *formats, size_t formatCount,
+                      char *buf, size_t bufLen) {
+  static const char levelChar[] = { 'D', 'I', 'W', 'E' };
+  char lv = rec.level < sizeof(levelChar) ? levelChar[rec.level] : '?';
+  int n = snprintf(buf, bufLen, "[%lu.%03lu %c] ", (unsigned long)(rec.tsUs / 1000000),
+                   (unsigned long)(rec.tsUs / 1000 % 1000), lv);
+  if (n < 0 || (size_t)n >= bufLen) return bufLen ? bufLen - 1 : 0;
+
+  int m;
+  if (rec.id < formatCount && formats[rec.id]) {
+    m = snprintf(buf + n, bufLen - n, formats[rec.id], (long)rec.args[0], (long)rec.args[1], (long)rec.args[2]);
+  } else {
+    m = snprintf(buf + n, bufLen - n, "event %u (%ld, %ld, %ld)", rec.id, (long)rec.args[0],
+                 (long)rec.args[1], (long)rec.args[2]);
+  }
+  if (m < 0) return n;
+  size_t len = n + m;
+  return len < bufLen ? len : bufLen - 1;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// === 延遲格式化的二進位 log ===
+// 熱路徑上只把 (時間戳, 事件 id, 最多 3 個整數參數) 寫進 RAM ring，
+// 不做字串格式化、不碰 Serial；低優先權的 drain task 之後再格式化輸出。
+// 事件 id 與格式字串由應用程式用 X-macro 定義（見 src/log_events.h），
+// tools/binlog_decode.py 讀同一個檔案解碼二進位輸出。
+// 等級在編譯期過濾：-DBINLOG_LEVEL=BINLOG_WARN 會讓 LOGD/LOGI 完全消失。
+
+#define BINLOG_DEBUG 0
+#define BINLOG_INFO  1
+#define BINLOG_WARN  2
+#define BINLOG_ERROR 3
+#define BINLOG_NONE  4
+
+#ifndef BINLOG_LEVEL
+#define BINLOG_LEVEL BINLOG_INFO
+#endif
+
+#ifndef BINLOG_CAPACITY
+#define BINLOG_CAPACITY 128 // 必須是 2 的次方
+#endif
+
+struct LogRecord {
+  uint32_t tsUs;
+  uint16_t id;
+  uint8_t level;
+  uint8_t nargs;
+  int32_t args[3];
+};
+
+// 二進位輸出格式：2 bytes sync + LogRecord（little endian，20 bytes）
+const uint8_t BINLOG_SYNC0 = 0xB1;
+const uint8_t BINLOG_SYNC1 = 0x06;
+
+class BinLog {
+public:
+  // 任何 context 都可呼叫（task 或 ISR），ring 滿時丟掉新的並計數
+  void write(uint8_t level, uint16_t id, uint8_t nargs, int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0);
+
+  // drain 端：一次取一筆
+  bool pop(LogRecord &rec);
+
+  // 用格式表把一筆記錄轉成文字，回傳長度
+  static size_t format(const LogRecord &rec, const char *const *formats, size_t formatCount,
+                       char *buf, size_t bufLen);
+
+  uint32_t dropped() const { return dropped_; }
+  uint32_t written() const { return written_; }
+  uint16_t pending() const;
+
+private:
+  static uint32_t nowUs();
+
+  LogRecord ring_[BINLOG_CAPACITY];
+  volatile uint32_t head_ = 0; // 下一個寫入位置
+  volatile uint32_t tail_ = 0; // 下一個讀取位置
+  volatile uint32_t dropped_ = 0;
+  volatile uint32_t written_ = 0;
+};
+
+extern BinLog binlog;
+
+#define BINLOG_NARGS_(...) BINLOG_NARGS_IMPL_(0, ##__VA_ARGS__, 3, 2, 1, 0)
+#define BINLOG_NARGS_IMPL_(_0, _1, _2, _3, N, ...) N
+#define BINLOG_WRITE_(level, id, ...) binlog.write(level, id, BINLOG_NARGS_(__VA_ARGS__), ##__VA_ARGS__)
+
+#if BINLOG_LEVEL <= BINLOG_DEBUG
+#define LOGD(id, ...) BINLOG_WRITE_(BINLOG_DEBUG, id, ##__VA_ARGS__)
+#else
+#define LOGD(id, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL <= BINLOG_INFO
+#define LOGI(id, ...) BINLOG_WRITE_(BINLOG_INFO, id, ##__VA_ARGS__)
+#else
+#define LOGI(id, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL <= BINLOG_WARN
+#define LOGW(id, ...) BINLOG_WRITE_(BINLOG_WARN, id, ##__VA_ARGS__)
+#else
+#define LOGW(id, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL <= BINLOG_ERROR
+#define LOGE(id, ...) BINLOG_WRITE_(BINLOG_ERROR, id, ##__VA_ARGS__)
+#else
+#define LOGE(id, ...) do {} while (0)
+#endif
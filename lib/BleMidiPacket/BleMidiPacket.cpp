@@ -0,0 +1,60 @@
+#include "BleMidiPacket.h"
+
+void BleMidiPacket::setMaxLen(uint8_t maxLen) {
+  if (maxLen > MAX_LEN) maxLen = MAX_LEN;
+  if (maxLen < 5) maxLen = 5; // header + 一則完整訊息
+  maxLen_ = maxLen;
+}
+
+void BleMidiPacket::clear() {
+  len_ = 0;
+  messages_ = 0;
+  lastStatus_ = 0;
+}
+
+bool BleMidiPacket::due(uint32_t nowMs, uint32_t intervalMs) const {
+  return len_ > 0 && nowMs - firstMs_ >= intervalMs;
+}
+
+bool BleMidiPacket::add(uint32_t timestampMs, uint8_t status, uint8_t d1, uint8_t d2) {
+  d1 &= 0x7F;
+  d2 &= 0x7F;
+
+  if (len_ == 0) {
+    firstMs_ = lastMs_ = timestampMs;
+    buf_[len_++] = 0x80 | ((timestampMs >> 7) & 0x3F);
+    buf_[len_++] = 0x80 | (timestampMs & 0x7F);
+    buf_[len_++] = status;
+    buf_[len_++] = d1;
+    buf_[len_++] = d2;
+    lastStatus_ = status;
+    messages_ = 1;
+    return true;
+  }
+
+  // 封包內時間戳必須遞增，且低 7 bits 最多繞回一次
+  if ((int32_t)(timestampMs - lastMs_) < 0) timestampMs = lastMs_;
+  if (timestampMs - firstMs_ > 127) return false;
+
+  bool running = status == lastStatus_;
+  bool sameTime = timestampMs == lastMs_;
+  uint8_t need = running ? (sameTime ? 2 : 3) : 4;
+  if (len_ + need > maxLen_) return false;
+
+  if (!(running && sameTime)) buf_[len_++] = 0x80 | (timestampMs & 0x7F);
+  if (!running) buf_[len_++] = status;
+  buf_[len_++] = d1;
+  buf_[len_++] = d2;
+  lastStatus_ = status;
+  lastMs_ = timestampMs;
+  messages_++;
+  return true;
+}
+
+bool BleMidiPacket::noteOn(uint32_t timestampMs, uint8_t channel, uint8_t note, uint8_t velocity) {
+  return add(timestampMs, 0x90 | (channel & 0x0F), note, velocity);
+}
+
+bool BleMidiPacket::noteOff(uint32_t timestampMs, uint8_t channel, uint8_t note) {
+  return add(timestampMs, 0x90 | (channel & 0x0F), note, 0);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+// === BLE-MIDI 封包合併 ===
+// 把一個 connection interval 內的所有 MIDI 訊息塞進同一個 notification：
+//   [header][ts][status][d1][d2] [ts][d1][d2] [d1][d2] ...
+// - header 帶 13-bit 毫秒時間戳的高 6 bits，每則訊息前的 ts byte 帶低 7 bits
+// - 與前一則 status 相同時省略 status（running status），
+//   時間戳也相同時連 ts byte 都省略
+// - note off 一律送成 velocity 0 的 note on，和弦放開時也能吃到 running status
+// 本身不依賴 Arduino / BLE，送出由呼叫端負責。
+
+class BleMidiPacket {
+public:
+  static const uint8_t MAX_LEN = 64;
+
+  // maxLen = ATT MTU - 3（預設 MTU 23 -> 20 bytes）
+  explicit BleMidiPacket(uint8_t maxLen = 20) { setMaxLen(maxLen); }
+
+  void setMaxLen(uint8_t maxLen);
+
+  // 放不下（封包滿或時間跨度超過 127 ms）時回傳 false，呼叫端先送出再 add
+  bool add(uint32_t timestampMs, uint8_t status, uint8_t d1, uint8_t d2);
+  bool noteOn(uint32_t timestampMs, uint8_t channel, uint8_t note, uint8_t velocity);
+  bool noteOff(uint32_t timestampMs, uint8_t channel, uint8_t note);
+
+  // 第一則訊息加入後經過 intervalMs 就該送出
+  bool due(uint32_t nowMs, uint32_t intervalMs) const;
+
+  bool empty() const { return len_ == 0; }
+  const uint8_t *data() const { return buf_; }
+  uint8_t size() const { return len_; }
+  uint8_t messages() const { return messages_; }
+  void clear();
+
+private:
+  uint8_t buf_[MAX_LEN];
+  uint8_t maxLen_ = 20;
+  uint8_t len_ = 0;
+  uint8_t messages_ = 0;
+  uint8_t lastStatus_ = 0;
+  uint32_t firstMs_ = 0;
+  uint32_t lastMs_ = 0;
+};
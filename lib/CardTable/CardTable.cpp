@@ -0,0 +1,91 @@
+#include "CardTable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const uint16_t EMPTY_SLOT = 0xFFFF;
+
+CardTable::~CardTable() {
+  free(slots_);
+}
+
+int CardTable::cardCompare(const CardEntry &a, const uint8_t *uid, uint8_t uidLen) {
+  if (a.uidLen != uidLen) return a.uidLen < uidLen ? -1 : 1;
+  return memcmp(a.uid, uid, uidLen);
+}
+
+// FNV-1a，UID 本身已經很亂，夠用了
+uint32_t CardTable::hashUid(const uint8_t *uid, uint8_t uidLen) {
+  uint32_t h = 2166136261u;
+  for (uint8_t i = 0; i < uidLen; i++) {
+    h ^= uid[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool CardTable::begin(const CardEntry *entries, size_t count) {
+  free(slots_);
+  slots_ = nullptr;
+  mask_ = 0;
+  entries_ = entries;
+  count_ = count;
+
+  // 檢查排序與重複（二分搜尋退路需要）
+  for (size_t i = 1; i < count; i++) {
+    if (cardCompare(entries[i - 1], entries[i].uid, entries[i].uidLen) >= 0) {
+      entries_ = nullptr;
+      count_ = 0;
+      return false;
+    }
+  }
+
+  // uint16_t 索引最多放 65534 張卡，超過就只用二分搜尋
+  if (count == 0 || count >= EMPTY_SLOT) return true;
+
+  // load factor <= 0.5
+  size_t slotCount = 1;
+  while (slotCount < count * 2) slotCount <<= 1;
+
+  slots_ = (uint16_t *)malloc(slotCount * sizeof(uint16_t));
+  if (!slots_) return true; // RAM 不足：退回二分搜尋
+  memset(slots_, 0xFF, slotCount * sizeof(uint16_t));
+  mask_ = slotCount - 1;
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t s = hashUid(entries[i].uid, entries[i].uidLen) & mask_;
+    while (slots_[s] != EMPTY_SLOT) s = (s + 1) & mask_;
+    slots_[s] = (uint16_t)i;
+  }
+  return true;
+}
+
+const CardEntry *CardTable::binarySearch(const uint8_t *uid, uint8_t uidLen) const {
+  size_t lo = 0, hi = count_;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int c = cardCompare(entries_[mid], uid, uidLen);
+    if (c == 0) return &entries_[mid];
+    if (c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return nullptr;
+}
+
+const CardEntry *CardTable::find(const uint8_t *uid, uint8_t uidLen) const {
+  if (!entries_ || uidLen == 0 || uidLen > CARD_UID_MAX) return nullptr;
+  if (!slots_) return binarySearch(uid, uidLen);
+
+  uint32_t s = hashUid(uid, uidLen) & mask_;
+  while (slots_[s] != EMPTY_SLOT) {
+    const CardEntry &e = entries_[slots_[s]];
+    if (cardCompare(e, uid, uidLen) == 0) return &e;
+    s = (s + 1) & mask_;
+  }
+  return nullptr;
+}
+
+CardRole CardTable::roleOf(const uint8_t *uid, uint8_t uidLen) const {
+  const CardEntry *e = find(uid, uidLen);
+  return e ? (CardRole)e->role : CARD_NONE;
+}
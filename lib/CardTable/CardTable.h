@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// === RFID 卡片權限表 ===
+// 卡片清單以「排序好的常數陣列」放在 flash，開機時在 RAM 建一個
+// open-addressing hash 索引（只存 uint16_t 位置），查詢為 O(1)。
+// 若 RAM 不足建不了索引，自動退回 flash 上的二分搜尋。
+
+const uint8_t CARD_UID_MAX = 10; // MFRC522 Uid 最長 10 bytes
+
+enum CardRole : uint8_t {
+  CARD_NONE      = 0,
+  CARD_DRIVER    = 1, // 車子駕駛卡
+  CARD_EMERGENCY = 2, // 緊急車輛優先通行（紅綠燈 preemption）
+  CARD_ADMIN     = 3,
+};
+
+struct CardEntry {
+  uint8_t uid[CARD_UID_MAX];
+  uint8_t uidLen;
+  uint8_t role;
+};
+
+class CardTable {
+public:
+  ~CardTable();
+
+  // entries 必須依 cardCompare() 排序（先比長度，再比 bytes）
+  // 回傳 false 表示清單未排序或有重複
+  bool begin(const CardEntry *entries, size_t count);
+
+  const CardEntry *find(const uint8_t *uid, uint8_t uidLen) const;
+  CardRole roleOf(const uint8_t *uid, uint8_t uidLen) const;
+
+  size_t size() const { return count_; }
+  bool indexed() const { return slots_ != nullptr; }
+
+  static int cardCompare(const CardEntry &a, const uint8_t *uid, uint8_t uidLen);
+
+private:
+  static uint32_t hashUid(const uint8_t *uid, uint8_t uidLen);
+  const CardEntry *binarySearch(const uint8_t *uid, uint8_t uidLen) const;
+
+  const CardEntry *entries_ = nullptr;
+  size_t count_ = 0;
+  uint16_t *slots_ = nullptr; // RAM 快取：entries_ 的位置，EMPTY_SLOT 表示空
+  uint32_t mask_ = 0;         // slot 數 - 1（2 的次方）
+};
@@ -0,0 +1,57 @@
+#include "CommandPath.h"
+
+bool CommandPath::joystick(int steer, int throttle, uint32_t seq, uint32_t rxUs, bool released, uint32_t nowUs) {
+  if (!estop_.allowsDrive(steer == 0 && throttle == 0, released)) {
+    rejected_++;
+    return false;
+  }
+  supersede();
+  seq_ = seq;
+  rxUs_ = rxUs;
+  accepted_++;
+  apply(steer, throttle, nowUs);
+  return true;
+}
+
+void CommandPath::control(int steer, int throttle, uint32_t nowUs) {
+  supersede();
+  seq_ = 0;
+  apply(steer, throttle, nowUs);
+}
+
+void CommandPath::outputApplied(uint32_t nowUs) {
+  if (pending_) report(nowUs);
+}
+
+void CommandPath::supersede() {
+  if (pending_ && seq_) superseded_++;
+  pending_ = false;
+}
+
+void CommandPath::apply(int steer, int throttle, uint32_t nowUs) {
+  motorA_ = throttle;
+  motorB_ = steer;
+  if (steer == 0 && throttle == 0) {
+    out_.driveA(0);
+    out_.driveB(0);
+    out_.enable(false);
+  } else {
+    out_.enable(true);
+    out_.driveA(throttle);
+    out_.driveB(steer);
+  }
+  // 停車或開迴路時輸出已經寫好
+  if (throttle != 0 && out_.deferA()) {
+    pending_ = true;
+    return;
+  }
+  report(nowUs);
+}
+
+void CommandPath::report(uint32_t nowUs) {
+  pending_ = false;
+  uint32_t seq = seq_;
+  if (seq) latency_.record(nowUs - rxUs_);
+  seq_ = 0;
+  out_.status(motorA_, motorB_, seq);
+}
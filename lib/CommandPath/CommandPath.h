@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <EmergencyStop.h>
+#include <LatencyStats.h>
+
+// === 搖桿指令路徑 ===
+// WebSocket frame 解析之後、到輸出真的寫進 PWM 為止的處理，main.cpp 和 native 測試共用：
+//   緊急停止檢查 -> 寫輸出（全部為 0 時關 STBY）-> 廣播狀態並帶回 frame 的 seq
+// 閉迴路行進中 Motor A 的 duty 由 speed loop 寫，廣播延到 outputApplied()；其他情況立刻廣播。
+// 還沒寫到 PWM 就被下一個指令蓋掉的算 superseded，不記延遲。
+// 硬體與廣播經由 CommandOutputs 的 callback；不依賴 Arduino，時間由呼叫端傳入。
+
+struct CommandOutputs {
+  void (*driveA)(int throttle);  // Motor A 指令（閉迴路時只設定輪速目標）
+  void (*driveB)(int steer);
+  void (*enable)(bool on);       // STBY
+  bool (*deferA)();              // Motor A 的輸出是否等 speed loop 寫
+  void (*status)(int motorA, int motorB, uint32_t seq);  // 廣播，seq 0 表示沒有
+};
+
+class CommandPath {
+public:
+  CommandPath(EmergencyStop &estop, const CommandOutputs &out) : estop_(estop), out_(out) {}
+
+  // 已解析的搖桿 frame；緊急停止 pending / 鎖定時回傳 false，輸出不變。
+  // released：實體緊急停止按鈕已放開
+  bool joystick(int steer, int throttle, uint32_t seq, uint32_t rxUs, bool released, uint32_t nowUs);
+
+  // AUTO 播放、watchdog、停車等內部指令（沒有 seq，不經緊急停止檢查）
+  void control(int steer, int throttle, uint32_t nowUs);
+
+  // speed loop 把 Motor A 的 duty 寫到 PWM 之後呼叫
+  void outputApplied(uint32_t nowUs);
+
+  int motorA() const { return motorA_; }
+  int motorB() const { return motorB_; }
+  bool pending() const { return pending_; }
+  uint32_t accepted() const { return accepted_; }
+  uint32_t rejected() const { return rejected_; }
+  uint32_t superseded() const { return superseded_; }
+  const LatencyStats &latency() const { return latency_; }
+
+private:
+  void apply(int steer, int throttle, uint32_t nowUs);
+  void report(uint32_t nowUs);
+  void supersede();
+
+  EmergencyStop &estop_;
+  CommandOutputs out_;
+  LatencyStats latency_;
+  int motorA_ = 0;
+  int motorB_ = 0;
+  uint32_t seq_ = 0;        // 等待回報的 frame seq
+  uint32_t rxUs_ = 0;       // 收到這個 frame 的時間
+  bool pending_ = false;    // 等 speed loop 寫 Motor A
+  uint32_t accepted_ = 0;
+  uint32_t rejected_ = 0;   // 緊急停止擋下的
+  uint32_t superseded_ = 0;
+};
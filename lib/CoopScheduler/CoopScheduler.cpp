@@ -0,0 +1,189 @@
+#include "CoopScheduler.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <time.h>
+#endif
+
+static CoopScheduler::ClockFn clockFn = nullptr;
+
+void CoopScheduler::setClock(ClockFn fn) {
+  clockFn = fn;
+}
+
+uint32_t CoopScheduler::nowUs() {
+  if (clockFn) return clockFn();
+#ifdef ARDUINO
+  return micros();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+#endif
+}
+
+// uint32_t us 約 71 分鐘繞回一次，一律用差值比較
+static inline int32_t diffUs(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b);
+}
+
+int CoopScheduler::add(const char *name, TaskFn fn, uint32_t periodUs, uint32_t delayUs,
+                       uint8_t priority, void *ctx, uint32_t budgetUs) {
+  if (!fn) return -1;
+  for (int i = 0; i < MAX_TASKS; i++) {
+    Task &t = tasks_[i];
+    if (t.used) continue;
+    t = Task();
+    t.name = name;
+    t.fn = fn;
+    t.ctx = ctx;
+    t.periodUs = periodUs;
+    t.budgetUs = budgetUs ? budgetUs : periodUs;
+    t.priority = priority;
+    t.deadline = nowUs() + delayUs;
+    t.used = true;
+    t.enabled = true;
+    return i;
+  }
+  return -1;
+}
+
+int CoopScheduler::addPeriodic(const char *name, TaskFn fn, uint32_t periodUs, uint8_t priority,
+                               void *ctx, uint32_t budgetUs) {
+  if (periodUs == 0) return -1;
+  return add(name, fn, periodUs, 0, priority, ctx, budgetUs);
+}
+
+int CoopScheduler::addOneShot(const char *name, TaskFn fn, uint32_t delayUs, uint8_t priority,
+                              void *ctx, uint32_t budgetUs) {
+  return add(name, fn, 0, delayUs, priority, ctx, budgetUs);
+}
+
+void CoopScheduler::cancel(int id) {
+  if (id < 0 || id >= MAX_TASKS) return;
+  tasks_[id].used = false;
+  tasks_[id].enabled = false;
+}
+
+void CoopScheduler::setEnabled(int id, bool enabled) {
+  if (id < 0 || id >= MAX_TASKS || !tasks_[id].used) return;
+  Task &t = tasks_[id];
+  if (enabled && !t.enabled) t.deadline = nowUs() + t.periodUs;
+  t.enabled = enabled;
+}
+
+void CoopScheduler::setPeriod(int id, uint32_t periodUs) {
+  if (id < 0 || id >= MAX_TASKS || !tasks_[id].used || periodUs == 0) return;
+  Task &t = tasks_[id];
+  if (t.budgetUs == t.periodUs) t.budgetUs = periodUs;
+  t.periodUs = periodUs;
+}
+
+void CoopScheduler::trigger(int id) {
+  if (id < 0 || id >= MAX_TASKS || !tasks_[id].used) return;
+  tasks_[id].deadline = nowUs();
+  tasks_[id].enabled = true;
+}
+
+int CoopScheduler::pickDue(uint32_t now) const {
+  int best = -1;
+  for (int i = 0; i < MAX_TASKS; i++) {
+    const Task &t = tasks_[i];
+    if (!t.used || !t.enabled || diffUs(now, t.deadline) < 0) continue;
+    if (best < 0 || t.priority > tasks_[best].priority ||
+        (t.priority == tasks_[best].priority && diffUs(t.deadline, tasks_[best].deadline) < 0)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void CoopScheduler::run(Task &t, uint32_t now) {
+  uint32_t late = (uint32_t)diffUs(now, t.deadline);
+
+  // 週期 task 先排好下一次 deadline（維持相位），落後太多就跳過錯過的週期
+  bool oneShot = t.periodUs == 0;
+  if (!oneShot) {
+    t.deadline += t.periodUs;
+    if (diffUs(now, t.deadline) >= 0) {
+      uint32_t behind = (uint32_t)diffUs(now, t.deadline) / t.periodUs + 1;
+      t.stats.missed += behind;
+      t.deadline += behind * t.periodUs;
+    }
+  } else {
+    t.enabled = false; // 執行期間呼叫 trigger() 可以重新排程
+  }
+
+  t.fn(t.ctx);
+
+  uint32_t took = nowUs() - now;
+  TaskStats &s = t.stats;
+  s.runs++;
+  s.lastUs = took;
+  s.totalUs += took;
+  if (took > s.maxUs) s.maxUs = took;
+  if (late > s.maxLateUs) s.maxLateUs = late;
+  if (t.budgetUs && took > t.budgetUs) s.overruns++;
+  busyUs_ += took;
+
+  if (oneShot && !t.enabled) t.used = false;
+}
+
+uint32_t CoopScheduler::runDue() {
+  // 每輪最多跑 MAX_TASKS 次，避免 trigger() 互相觸發造成無窮迴圈
+  for (int n = 0; n < MAX_TASKS; n++) {
+    uint32_t now = nowUs();
+    int id = pickDue(now);
+    if (id < 0) break;
+    run(tasks_[id], now);
+  }
+
+  uint32_t now = nowUs();
+  windowUs_ += now - windowMarkUs_;
+  windowMarkUs_ = now;
+
+  uint32_t wait = UINT32_MAX;
+  for (int i = 0; i < MAX_TASKS; i++) {
+    const Task &t = tasks_[i];
+    if (!t.used || !t.enabled) continue;
+    int32_t d = diffUs(t.deadline, now);
+    uint32_t w = d > 0 ? (uint32_t)d : 0;
+    if (w < wait) wait = w;
+  }
+  return wait;
+}
+
+uint8_t CoopScheduler::taskCount() const {
+  uint8_t n = 0;
+  for (int i = 0; i < MAX_TASKS; i++) {
+    if (tasks_[i].used) n++;
+  }
+  return n;
+}
+
+bool CoopScheduler::taskInfo(int id, TaskInfo &info) const {
+  if (id < 0 || id >= MAX_TASKS || !tasks_[id].used) return false;
+  const Task &t = tasks_[id];
+  info.name = t.name;
+  info.priority = t.priority;
+  info.periodUs = t.periodUs;
+  info.budgetUs = t.budgetUs;
+  info.enabled = t.enabled;
+  info.stats = &t.stats;
+  return true;
+}
+
+void CoopScheduler::resetStats() {
+  for (int i = 0; i < MAX_TASKS; i++) tasks_[i].stats = TaskStats();
+  busyUs_ = 0;
+  windowUs_ = 0;
+  windowMarkUs_ = nowUs();
+}
+
+uint16_t CoopScheduler::loadPermille() const {
+  uint64_t elapsed = windowUs_ + (uint32_t)(nowUs() - windowMarkUs_);
+  if (elapsed == 0) return 0;
+  uint64_t p = busyUs_ * 1000 / elapsed;
+  return p > 1000 ? 1000 : (uint16_t)p;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// === 協作式 deadline 排程器 ===
+// 取代各 sketch 裡的 delay() / millis() 比較：工作註冊成週期或單次 task，
+// loop() 只呼叫 runDue()。到期的 task 依 priority（數字大者優先）執行，
+// 同 priority 時 deadline 早者先跑。task 不可阻塞，跑超過 budget 記一次 overrun。
+// ESP32 用 micros()，native (Linux) 用 CLOCK_MONOTONIC，其餘不依賴 Arduino。
+// 測試可用 setClock() 換成假時鐘。
+
+typedef void (*TaskFn)(void *ctx);
+
+struct TaskStats {
+  uint32_t runs = 0;
+  uint32_t overruns = 0;   // 執行時間超過 budget
+  uint32_t missed = 0;     // 落後超過一個週期而跳過的次數
+  uint32_t lastUs = 0;
+  uint32_t maxUs = 0;
+  uint32_t maxLateUs = 0;  // 實際開始時間 - deadline
+  uint64_t totalUs = 0;
+
+  uint32_t avgUs() const { return runs ? (uint32_t)(totalUs / runs) : 0; }
+};
+
+struct TaskInfo {
+  const char *name;
+  uint8_t priority;
+  uint32_t periodUs; // 0 = 單次
+  uint32_t budgetUs;
+  bool enabled;
+  const TaskStats *stats;
+};
+
+class CoopScheduler {
+public:
+  static const uint8_t MAX_TASKS = 16;
+
+  typedef uint32_t (*ClockFn)();
+
+  static uint32_t nowUs();
+  static void setClock(ClockFn fn); // nullptr = 還原成系統時鐘
+
+  // 回傳 task id；滿了回傳 -1。budgetUs = 0 代表以週期為 budget
+  int addPeriodic(const char *name, TaskFn fn, uint32_t periodUs, uint8_t priority,
+                  void *ctx = nullptr, uint32_t budgetUs = 0);
+  int addOneShot(const char *name, TaskFn fn, uint32_t delayUs, uint8_t priority,
+                 void *ctx = nullptr, uint32_t budgetUs = 0);
+
+  void cancel(int id);
+  void setEnabled(int id, bool enabled);
+  void setPeriod(int id, uint32_t periodUs);
+  void trigger(int id); // 下一次 runDue() 立刻執行
+
+  // 跑完所有已到期的 task，回傳距離下一個 deadline 的 us（沒有 task 時回傳 UINT32_MAX）
+  uint32_t runDue();
+
+  uint8_t taskCount() const;
+  bool taskInfo(int id, TaskInfo &info) const;
+  void resetStats();
+
+  // 自 resetStats() 起 task 佔用的 CPU 比例（0.1% 為單位）
+  uint16_t loadPermille() const;
+
+private:
+  struct Task {
+    const char *name = nullptr;
+    TaskFn fn = nullptr;
+    void *ctx = nullptr;
+    uint32_t periodUs = 0;
+    uint32_t budgetUs = 0;
+    uint32_t deadline = 0;
+    uint8_t priority = 0;
+    bool used = false;
+    bool enabled = false;
+    TaskStats stats;
+  };
+
+  int add(const char *name, TaskFn fn, uint32_t periodUs, uint32_t delayUs, uint8_t priority,
+          void *ctx, uint32_t budgetUs);
+  int pickDue(uint32_t now) const;
+  void run(Task &t, uint32_t now);
+
+  Task tasks_[MAX_TASKS];
+  // 統計視窗用 64 位元累加：每次 runDue() 把 32 位元差值加進 windowUs_，
+  // 只要兩次 runDue() 間隔小於 71 分鐘就不會繞回
+  uint32_t windowMarkUs_ = nowUs();
+  uint64_t windowUs_ = 0;
+  uint64_t busyUs_ = 0;
+};
@@ -0,0 +1,28 @@
+#include "EmergencyStop.h"
+
+void IRAM_ATTR EmergencyStop::request(uint8_t source, uint32_t nowUs) {
+  if (pending_) return;
+  requestUs_ = nowUs;
+  source_ = source;
+  pending_ = true;
+}
+
+bool EmergencyStop::complete(uint32_t nowUs) {
+  if (!pending_) return false;
+  latched_ = true;
+  lastUs_ = nowUs - requestUs_;
+  if (lastUs_ > maxUs_) maxUs_ = lastUs_;
+  count_++;
+  pending_ = false;
+  return true;
+}
+
+bool EmergencyStop::allowsDrive(bool centered, bool released) {
+  if (pending_) return false;
+  if (!latched_) return true;
+  if (centered && released) {
+    latched_ = false;
+    clears_++;
+  }
+  return false;
+}
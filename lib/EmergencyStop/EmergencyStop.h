@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// === 緊急停止狀態 ===
+// 兩段式：request() 在觸發當下（ISR、WebSocket、WiFi 事件）記錄來源與時間，呼叫端
+// 同時自行切 STBY；complete() 由最高優先權的週期 task 在 PWM 歸零後呼叫，進入鎖定。
+// pending（已切 STBY、尚未收尾）或 latched 期間 allowsEnable() 都是 false，
+// 避免控制迴圈在收尾前把 STBY 又打開。不依賴 Arduino，時間由呼叫端傳入。
+
+class EmergencyStop {
+public:
+  // ISR-safe；已在 pending 時只保留第一次的來源與時間
+  void request(uint8_t source, uint32_t nowUs);
+
+  // 收尾：清 pending、進入 latched、更新統計；沒有 pending 時回傳 false
+  bool complete(uint32_t nowUs);
+
+  // 搖桿 frame 是否可以驅動。pending 時一律拒絕；latched 時只有回中
+  // （centered）且觸發源已放開（released，例如按鈕）才解除，該 frame 本身仍被拒絕
+  bool allowsDrive(bool centered, bool released);
+
+  // 是否可以開啟 STBY
+  bool allowsEnable() const { return !pending_ && !latched_; }
+
+  bool pending() const { return pending_; }
+  bool latched() const { return latched_; }
+  uint8_t source() const { return source_; }
+  uint32_t count() const { return count_; }
+  uint32_t lastUs() const { return lastUs_; }  // 觸發 -> complete()
+  uint32_t maxUs() const { return maxUs_; }
+  uint32_t clears() const { return clears_; }
+
+private:
+  volatile bool pending_ = false;
+  volatile uint32_t requestUs_ = 0;
+  volatile uint8_t source_ = 0;
+  bool latched_ = false;
+  uint32_t count_ = 0;
+  uint32_t lastUs_ = 0;
+  uint32_t maxUs_ = 0;
+  uint32_t clears_ = 0;
+};
@@ -0,0 +1,81 @@
+#include "IdlePower.h"
+
+void IdlePower::begin(uint32_t nowMs) {
+  state_ = POWER_ACTIVE;
+  lastActivityMs_ = nowMs;
+  enteredMs_ = nowMs;
+  beganMs_ = nowMs;
+  transitions_ = 0;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) timeMs_[i] = 0;
+  currentMa_ = profile_.currentMa[POWER_ACTIVE];
+  segmentMs_ = nowMs;
+  chargeMaMs_ = 0;
+}
+
+void IdlePower::closeSegment(uint32_t nowMs) {
+  chargeMaMs_ += (uint64_t)(nowMs - segmentMs_) * currentMa_;
+  segmentMs_ = nowMs;
+}
+
+void IdlePower::enter(PowerState s, uint32_t nowMs) {
+  closeSegment(nowMs);
+  timeMs_[state_] += nowMs - enteredMs_;
+  state_ = s;
+  enteredMs_ = nowMs;
+  currentMa_ = profile_.currentMa[s];
+  transitions_++;
+}
+
+void IdlePower::setCurrentMa(uint16_t mA, uint32_t nowMs) {
+  closeSegment(nowMs);
+  currentMa_ = mA;
+}
+
+bool IdlePower::activity(uint32_t nowMs) {
+  lastActivityMs_ = nowMs;
+  if (state_ == POWER_ACTIVE) return false;
+  enter(POWER_ACTIVE, nowMs);
+  return true;
+}
+
+bool IdlePower::update(uint32_t nowMs, bool canPark) {
+  uint32_t quietMs = nowMs - lastActivityMs_;
+  PowerState next = POWER_ACTIVE;
+  if (canPark && quietMs >= profile_.parkAfterMs) {
+    next = POWER_PARKED;
+  } else if (quietMs >= profile_.idleAfterMs) {
+    next = POWER_IDLE;
+  }
+  if (next == state_) return false;
+  enter(next, nowMs);
+  return true;
+}
+
+uint64_t IdlePower::timeInStateMs(PowerState s, uint32_t nowMs) const {
+  uint64_t t = timeMs_[s];
+  if (s == state_) t += nowMs - enteredMs_;
+  return t;
+}
+
+uint64_t IdlePower::chargeMaMs(uint32_t nowMs) const {
+  return chargeMaMs_ + (uint64_t)(nowMs - segmentMs_) * currentMa_;
+}
+
+uint32_t IdlePower::averageCurrentMa(uint32_t nowMs) const {
+  uint32_t total = nowMs - beganMs_;
+  if (total == 0) return currentMa();
+  return (uint32_t)(chargeMaMs(nowMs) / total);
+}
+
+uint32_t IdlePower::consumedMah(uint32_t nowMs) const {
+  return (uint32_t)(chargeMaMs(nowMs) / 3600000ULL);
+}
+
+const char *IdlePower::name(PowerState s) {
+  switch (s) {
+    case POWER_ACTIVE: return "active";
+    case POWER_IDLE: return "idle";
+    case POWER_PARKED: return "parked";
+    default: return "?";
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+// === 閒置省電狀態機 ===
+// ACTIVE：有指令或車在動，全速。
+// IDLE：idleAfterMs 沒有活動，降頻（馬達已停）。
+// PARKED：parkAfterMs 沒有活動且允許時（例如沒有 WebSocket client），進 light sleep。
+// 任何活動立刻回 ACTIVE。這裡只管狀態與計時，實際的時脈 / sleep 設定由呼叫端套用，
+// 耗電是依各狀態的典型電流估算；呼叫端實際套用的設定和 profile 不同時（例如
+// light sleep 開不起來）用 setCurrentMa() 修正這段狀態的估計。
+// 不依賴 Arduino，可直接在 native 下跑。
+
+enum PowerState : uint8_t { POWER_ACTIVE = 0, POWER_IDLE, POWER_PARKED, POWER_STATE_COUNT };
+
+struct PowerProfile {
+  uint32_t idleAfterMs;
+  uint32_t parkAfterMs;
+  uint16_t currentMa[POWER_STATE_COUNT];  // 各狀態的估計平均電流
+};
+
+class IdlePower {
+public:
+  explicit IdlePower(const PowerProfile &profile) : profile_(profile) {}
+
+  void begin(uint32_t nowMs);
+
+  // 有指令 / 網路活動；原本不在 ACTIVE 時回傳 true（呼叫端要立刻恢復全速）
+  bool activity(uint32_t nowMs);
+
+  // 週期呼叫；狀態改變時回傳 true。canPark = false 時最多停在 IDLE
+  bool update(uint32_t nowMs, bool canPark);
+
+  PowerState state() const { return state_; }
+  uint32_t transitions() const { return transitions_; }
+  uint64_t timeInStateMs(PowerState s, uint32_t nowMs) const;
+  uint16_t currentMa() const { return currentMa_; }
+  // 從 nowMs 起到離開目前狀態為止改用 mA 估算（進入新狀態時回到 profile 的值）
+  void setCurrentMa(uint16_t mA, uint32_t nowMs);
+  uint32_t averageCurrentMa(uint32_t nowMs) const;
+  uint32_t consumedMah(uint32_t nowMs) const;
+
+  static const char *name(PowerState s);
+
+private:
+  void enter(PowerState s, uint32_t nowMs);
+  void closeSegment(uint32_t nowMs);
+  uint64_t chargeMaMs(uint32_t nowMs) const;
+
+  PowerProfile profile_;
+  PowerState state_ = POWER_ACTIVE;
+  uint32_t lastActivityMs_ = 0;
+  uint32_t enteredMs_ = 0;
+  uint32_t beganMs_ = 0;
+  uint32_t transitions_ = 0;
+  uint64_t timeMs_[POWER_STATE_COUNT] = {};  // 已離開的各段累計
+  uint16_t currentMa_ = 0;                   // 目前這段的估計電流
+  uint32_t segmentMs_ = 0;                   // 目前這段的開始時間
+  uint64_t chargeMaMs_ = 0;                  // 已結束各段的 mA * ms
+};
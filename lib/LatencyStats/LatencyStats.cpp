@@ -0,0 +1,46 @@
+#include "LatencyStats.h"
+
+uint8_t LatencyStats::bucketOf(uint32_t us) {
+  if (us < 8) return (uint8_t)us;
+  int msb = 31 - __builtin_clz(us);
+  return (uint8_t)((msb - 1) * 4 + ((us >> (msb - 2)) & 3));
+}
+
+uint32_t LatencyStats::bucketUpper(uint8_t b) {
+  if (b < 8) return b;
+  int msb = b / 4 + 1;
+  uint32_t width = 1UL << (msb - 2);
+  uint64_t lower = (uint64_t)(4 + b % 4) * width;
+  uint64_t upper = lower + width - 1;
+  return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
+
+void LatencyStats::record(uint32_t us) {
+  buckets_[bucketOf(us)]++;
+  count_++;
+  last_ = us;
+  if (us > max_) max_ = us;
+}
+
+void LatencyStats::reset() {
+  for (uint8_t i = 0; i < BUCKETS; i++) buckets_[i] = 0;
+  count_ = 0;
+  last_ = 0;
+  max_ = 0;
+}
+
+uint32_t LatencyStats::percentile(uint8_t p) const {
+  if (count_ == 0) return 0;
+  if (p > 100) p = 100;
+  uint64_t target = ((uint64_t)count_ * p + 99) / 100;
+  if (target == 0) target = 1;
+  uint64_t seen = 0;
+  for (uint8_t b = 0; b < BUCKETS; b++) {
+    seen += buckets_[b];
+    if (seen >= target) {
+      uint32_t upper = bucketUpper(b);
+      return upper < max_ ? upper : max_;
+    }
+  }
+  return max_;
+}
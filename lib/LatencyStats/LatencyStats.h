@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+// === 延遲分布 ===
+// 固定大小的對數直方圖：每個 2 倍區間分 4 格（誤差 < 25%），0..7 us 各自一格。
+// record() O(1)、不配置記憶體，可在控制路徑上呼叫；percentile() 回傳該格上界
+// （不超過實際最大值）。不依賴 Arduino，可直接在 native 下跑。
+
+class LatencyStats {
+public:
+  static const uint8_t BUCKETS = 124;
+
+  void record(uint32_t us);
+  void reset();
+
+  uint32_t count() const { return count_; }
+  uint32_t lastUs() const { return last_; }
+  uint32_t maxUs() const { return max_; }
+  uint32_t percentile(uint8_t p) const;  // p = 0..100
+
+  static uint8_t bucketOf(uint32_t us);
+  static uint32_t bucketUpper(uint8_t b);
+
+private:
+  uint32_t buckets_[BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint32_t last_ = 0;
+  uint32_t max_ = 0;
+};
@@ -0,0 +1,139 @@
+#include "MidiSequencer.h"
+
+uint64_t MidiSequencer::tickToUs(const Song &song, uint32_t tick) {
+  // 一拍 = 60e6 / bpm us
+  return (uint64_t)tick * 60000000ULL / ((uint64_t)song.bpm * song.ticksPerBeat);
+}
+
+int MidiSequencer::play(const Song &song, uint64_t nowUs) {
+  if (song.count == 0 || song.bpm == 0 || song.ticksPerBeat == 0) return -1;
+  for (uint8_t i = 0; i < MAX_VOICES; i++) {
+    if (voices_[i].song) continue;
+    voices_[i].song = &song;
+    voices_[i].next = 0;
+    voices_[i].startUs = nowUs;
+    return i;
+  }
+  return -1;
+}
+
+bool MidiSequencer::isPlaying(uint8_t voice) const {
+  if (voice >= MAX_VOICES) return false;
+  if (voices_[voice].song) return true;
+  for (uint8_t i = 0; i < queueLen_; i++) {
+    if (queue_[i].voice == voice) return true;
+  }
+  return false;
+}
+
+bool MidiSequencer::busy() const {
+  for (uint8_t i = 0; i < MAX_VOICES; i++) {
+    if (voices_[i].song) return true;
+  }
+  return queueLen_ > 0;
+}
+
+void MidiSequencer::stop(uint8_t voice) {
+  if (voice >= MAX_VOICES) return;
+  voices_[voice].song = nullptr;
+
+  // 送出這個 voice 剩下的 note off，其他事件放回 heap
+  MidiEvent keep[QUEUE_SIZE];
+  uint8_t n = 0;
+  while (queueLen_ > 0) {
+    MidiEvent ev = pop();
+    if (ev.voice != voice) keep[n++] = ev;
+    else if (ev.velocity == 0) out_(ev, ctx_);
+  }
+  for (uint8_t i = 0; i < n; i++) push(keep[i]);
+}
+
+void MidiSequencer::stopAll() {
+  for (uint8_t i = 0; i < MAX_VOICES; i++) voices_[i].song = nullptr;
+  while (queueLen_ > 0) {
+    MidiEvent ev = pop();
+    if (ev.velocity == 0) out_(ev, ctx_);
+  }
+}
+
+uint64_t MidiSequencer::nextDueUs() const {
+  uint64_t due = queueLen_ ? queue_[0].dueUs : UINT64_MAX;
+  for (uint8_t i = 0; i < MAX_VOICES; i++) {
+    const Voice &v = voices_[i];
+    if (!v.song) continue;
+    uint64_t t = v.startUs + tickToUs(*v.song, v.song->notes[v.next].startTick);
+    if (t < due) due = t;
+  }
+  return due;
+}
+
+void MidiSequencer::service(uint64_t nowUs) {
+  // 把到期的音符拆成 on/off 放進 queue
+  for (uint8_t i = 0; i < MAX_VOICES; i++) {
+    Voice &v = voices_[i];
+    while (v.song && v.next < v.song->count) {
+      const SongNote &n = v.song->notes[v.next];
+      uint64_t onUs = v.startUs + tickToUs(*v.song, n.startTick);
+      if (onUs > nowUs) break;
+      // 保留空間給 note off，避免留下卡住的音
+      if (queueLen_ + 2 > QUEUE_SIZE) {
+        stats_.dropped++;
+      } else {
+        uint64_t offUs = v.startUs + tickToUs(*v.song, n.startTick + n.lengthTicks);
+        push({ onUs, i, v.song->channel, n.note, n.velocity ? n.velocity : (uint8_t)1 });
+        push({ offUs, i, v.song->channel, n.note, 0 });
+      }
+      v.next++;
+    }
+    if (v.song && v.next >= v.song->count) v.song = nullptr; // 只剩 queue 裡的 note off
+  }
+
+  while (queueLen_ > 0 && queue_[0].dueUs <= nowUs) {
+    emit(pop(), nowUs);
+  }
+}
+
+void MidiSequencer::emit(const MidiEvent &ev, uint64_t nowUs) {
+  uint32_t late = (uint32_t)(nowUs - ev.dueUs);
+  stats_.events++;
+  stats_.totalLateUs += late;
+  if (late > stats_.maxLateUs) stats_.maxLateUs = late;
+  out_(ev, ctx_);
+}
+
+// ---- min-heap（依 dueUs；同時間 note off 先送，避免同音重按被吃掉）----
+static bool earlier(const MidiEvent &a, const MidiEvent &b) {
+  if (a.dueUs != b.dueUs) return a.dueUs < b.dueUs;
+  return a.velocity < b.velocity;
+}
+
+void MidiSequencer::push(const MidiEvent &ev) {
+  if (queueLen_ >= QUEUE_SIZE) {
+    stats_.dropped++;
+    return;
+  }
+  uint8_t i = queueLen_++;
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (!earlier(ev, queue_[parent])) break;
+    queue_[i] = queue_[parent];
+    i = parent;
+  }
+  queue_[i] = ev;
+}
+
+MidiEvent MidiSequencer::pop() {
+  MidiEvent top = queue_[0];
+  MidiEvent last = queue_[--queueLen_];
+  uint8_t i = 0;
+  while (true) {
+    uint8_t child = i * 2 + 1;
+    if (child >= queueLen_) break;
+    if (child + 1 < queueLen_ && earlier(queue_[child + 1], queue_[child])) child++;
+    if (!earlier(queue_[child], last)) break;
+    queue_[i] = queue_[child];
+    i = child;
+  }
+  if (queueLen_ > 0) queue_[i] = last;
+  return top;
+}
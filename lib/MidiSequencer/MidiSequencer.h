@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// === 非阻塞 MIDI 音序器 ===
+// 歌曲是依 startTick 排序的音符表；每首歌一個 voice，可多首同時播放。
+// 所有 note on/off 依「開始時間 + tick 換算」算出絕對時間放進 min-heap，
+// 不做累加 delay，所以不會因為 BLE 或 loop() 延遲而漂移。
+// 時間由呼叫端傳入（ESP32 用 esp_timer_get_time()，單位 us），本身不依賴 Arduino。
+
+struct SongNote {
+  uint32_t startTick;
+  uint32_t lengthTicks;
+  uint8_t note;
+  uint8_t velocity;
+};
+
+struct Song {
+  const SongNote *notes;
+  uint16_t count;
+  uint8_t channel;
+  uint16_t ticksPerBeat;
+  uint16_t bpm;
+};
+
+struct MidiEvent {
+  uint64_t dueUs;
+  uint8_t voice;
+  uint8_t channel;
+  uint8_t note;
+  uint8_t velocity; // 0 = note off
+};
+
+struct SequencerStats {
+  uint32_t events = 0;
+  uint32_t maxLateUs = 0; // 實際送出時間 - 排定時間
+  uint64_t totalLateUs = 0;
+  uint32_t dropped = 0;   // queue 滿丟掉的事件
+
+  uint32_t avgLateUs() const { return events ? (uint32_t)(totalLateUs / events) : 0; }
+};
+
+typedef void (*MidiOutFn)(const MidiEvent &ev, void *ctx);
+
+class MidiSequencer {
+public:
+  static const uint8_t MAX_VOICES = 4;
+  static const uint8_t QUEUE_SIZE = 32;
+
+  MidiSequencer(MidiOutFn out, void *ctx = nullptr) : out_(out), ctx_(ctx) {}
+
+  // 開始播放，回傳 voice 編號；沒有空 voice 時回傳 -1
+  int play(const Song &song, uint64_t nowUs);
+  // 停止 voice，尚未送出的 note off 立刻送出
+  void stop(uint8_t voice);
+  void stopAll();
+
+  // 放在 loop()：送出所有已到期的事件
+  void service(uint64_t nowUs);
+
+  bool isPlaying(uint8_t voice) const;
+  bool busy() const;
+
+  // 下一個事件的時間（沒事件時回傳 UINT64_MAX），可用來設定 timer 喚醒
+  uint64_t nextDueUs() const;
+
+  const SequencerStats &stats() const { return stats_; }
+  void resetStats() { stats_ = SequencerStats(); }
+
+private:
+  struct Voice {
+    const Song *song = nullptr;
+    uint16_t next = 0;
+    uint64_t startUs = 0;
+  };
+
+  static uint64_t tickToUs(const Song &song, uint32_t tick);
+
+  void push(const MidiEvent &ev);
+  MidiEvent pop();
+  void emit(const MidiEvent &ev, uint64_t nowUs);
+
+  MidiOutFn out_;
+  void *ctx_;
+  Voice voices_[MAX_VOICES];
+  MidiEvent queue_[QUEUE_SIZE];
+  uint8_t queueLen_ = 0;
+  SequencerStats stats_;
+};
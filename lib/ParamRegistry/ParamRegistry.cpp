@@ -0,0 +1,111 @@
+#include "ParamRegistry.h"
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#endif
+
+ParamRegistry::ParamRegistry(const ParamDef *defs, uint8_t count)
+  : defs_(defs), count_(count < MAX_PARAMS ? count : MAX_PARAMS) {
+  resetDefaults();
+  dirty_ = 0;
+  generation_ = 0;
+}
+
+int ParamRegistry::find(const char *key) const {
+  if (!key) return -1;
+  for (uint8_t i = 0; i < count_; i++) {
+    if (strcmp(defs_[i].key, key) == 0) return i;
+  }
+  return -1;
+}
+
+// seq_ 偶數 = 沒在寫，奇數 = 正在寫備用的那份；目前的值是 bank_[(seq_ >> 1) & 1]
+void ParamRegistry::current(int32_t *out) const {
+  uint32_t bank = (seq_.load(std::memory_order_relaxed) >> 1) & 1;
+  for (uint8_t i = 0; i < count_; i++) out[i] = bank_[bank][i].load(std::memory_order_relaxed);
+}
+
+// 只有 loop 會寫，不需要鎖
+void ParamRegistry::publish(const int32_t *values) {
+  uint32_t seq = seq_.load(std::memory_order_relaxed);
+  uint32_t next = ((seq >> 1) + 1) & 1;
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (uint8_t i = 0; i < count_; i++) bank_[next][i].store(values[i], std::memory_order_relaxed);
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+void ParamRegistry::snapshot(int32_t *out) const {
+  for (;;) {
+    uint32_t seq = seq_.load(std::memory_order_acquire);
+    uint32_t bank = (seq >> 1) & 1;
+    for (uint8_t i = 0; i < count_; i++) out[i] = bank_[bank][i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // 下一次開始寫這一份時 seq_ 會到 (seq & ~1) + 3，之前都是安全的
+    if (seq_.load(std::memory_order_relaxed) - (seq & ~1u) < 3) return;
+  }
+}
+
+bool ParamRegistry::valid(uint8_t id, int32_t value) const {
+  return id < count_ && value >= defs_[id].min && value <= defs_[id].max;
+}
+
+int ParamRegistry::apply(const ParamUpdate *updates, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    if (!valid(updates[i].id, updates[i].value)) return i;
+  }
+
+  int32_t values[MAX_PARAMS];
+  current(values);
+  uint32_t changed = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    uint8_t id = updates[i].id;
+    if (values[id] == updates[i].value) continue;
+    values[id] = updates[i].value;
+    changed |= 1UL << id;
+  }
+  if (changed) {
+    publish(values);
+    changed_ = changed;
+    dirty_ |= changed;
+    generation_++;
+  }
+  return -1;
+}
+
+void ParamRegistry::resetDefaults() {
+  int32_t values[MAX_PARAMS];
+  current(values);
+  uint32_t changed = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    if (values[i] != defs_[i].def) changed |= 1UL << i;
+    values[i] = defs_[i].def;
+  }
+  publish(values);
+  changed_ = changed;
+  dirty_ |= changed;
+  generation_++;
+}
+
+#ifdef ARDUINO
+void ParamRegistry::load(Preferences &prefs) {
+  int32_t values[MAX_PARAMS];
+  for (uint8_t i = 0; i < count_; i++) {
+    int32_t v = prefs.getInt(defs_[i].key, defs_[i].def);
+    values[i] = valid(i, v) ? v : defs_[i].def;
+  }
+  publish(values);
+  changed_ = (1UL << count_) - 1;
+  dirty_ = 0;
+  generation_++;
+}
+
+void ParamRegistry::save(Preferences &prefs) {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (dirty_ & (1UL << i)) prefs.putInt(defs_[i].key, get(i));
+  }
+  dirty_ = 0;
+}
+#endif
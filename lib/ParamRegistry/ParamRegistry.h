@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// === 可調參數表 ===
+// 每個參數一個 id（陣列 index），控制迴圈用 get(id) 直接讀，O(1)、不查字串。
+// apply() 一次更新一批：全部通過範圍檢查才一起寫入，任何一個不合法就整批不動。
+// apply() 只能在 loop 這邊呼叫；其他 task（例如 HTTP）要先排隊再交給 loop 套用。
+// 其他 task 要讀整組值用 snapshot()：值存成兩份，apply() 寫不在使用中的那份再切換，
+// 讀的一方只在讀的那份又開始被改寫時才重讀，不會看到半批新、半批舊，也不會等寫入端
+// （單核上低優先權的 loop 被搶佔時，自旋等它寫完會卡死）。
+// ESP32 上用 Preferences 存在 nvs 分割區，key 就是參數名稱（NVS 限 15 字元）。
+
+#ifdef ARDUINO
+class Preferences;
+#endif
+
+struct ParamDef {
+  const char *key;
+  int32_t min;
+  int32_t max;
+  int32_t def;
+};
+
+struct ParamUpdate {
+  uint8_t id;
+  int32_t value;
+};
+
+class ParamRegistry {
+public:
+  static const uint8_t MAX_PARAMS = 16;
+
+  ParamRegistry(const ParamDef *defs, uint8_t count);
+
+  int32_t get(uint8_t id) const {
+    return bank_[(seq_.load(std::memory_order_acquire) >> 1) & 1][id].load(std::memory_order_relaxed);
+  }
+  // 一致的整組值（count() 個），任何 task 都可以呼叫
+  void snapshot(int32_t *out) const;
+  uint8_t count() const { return count_; }
+  const ParamDef &def(uint8_t id) const { return defs_[id]; }
+  int find(const char *key) const;  // 找不到回傳 -1
+  bool valid(uint8_t id, int32_t value) const;
+
+  // 回傳 -1 表示整批已套用，否則為第一個不合法項目的 index
+  int apply(const ParamUpdate *updates, uint8_t n);
+  void resetDefaults();
+
+  // 每次成功 apply 加 1，使用端比對後重新套用衍生設定（PWM 頻率、PID 增益…）
+  uint32_t generation() const { return generation_; }
+  uint32_t changedMask() const { return changed_; }  // 最近一次 apply 改到的參數
+
+#ifdef ARDUINO
+  void load(Preferences &prefs);  // 存值不合法時回到預設值
+  void save(Preferences &prefs);  // 只寫入還沒存過的變更
+#endif
+
+private:
+  void publish(const int32_t *values);  // 寫入備用的那份後切換
+  void current(int32_t *out) const;     // loop 這邊讀目前的值
+
+  const ParamDef *defs_;
+  uint8_t count_;
+  std::atomic<int32_t> bank_[2][MAX_PARAMS] = {};
+  std::atomic<uint32_t> seq_{0};        // 每次 publish 加 2，寫入中為奇數
+  uint32_t changed_ = 0;
+  uint32_t dirty_ = 0;     // 尚未寫入 NVS
+  uint32_t generation_ = 0;
+};
@@ -0,0 +1,229 @@
+#include "RC522Fast.h"
+
+// ComIEnReg / DivIEnReg 位元
+static const byte IRQ_INV       = 0x80; // IRQ 腳低電位有效
+static const byte IRQ_PUSH_PULL = 0x80; // DivIEnReg：IRQ 腳推挽輸出
+static const byte RX_IEN        = 0x20;
+static const byte ERR_IEN       = 0x02;
+static const byte TIMER_IEN     = 0x01;
+
+// ComIrqReg / ErrorReg 位元
+static const byte RX_IRQ        = 0x20;
+static const byte ERR_COLL      = 0x08;
+static const byte ERR_FATAL     = 0x13; // BufferOvfl | ParityErr | ProtocolErr
+
+static const uint32_t PICC_TIMEOUT_US = 5000;
+
+void RC522Timing::add(uint32_t us) {
+  if (count == 0 || us < minUs) minUs = us;
+  if (us > maxUs) maxUs = us;
+  totalUs += us;
+  count++;
+}
+
+// ISO/IEC 14443-3 CRC_A（init 0x6363）
+static void crcA(const byte *data, byte len, byte *out) {
+  uint16_t crc = 0x6363;
+  for (byte i = 0; i < len; i++) {
+    byte ch = data[i] ^ (byte)(crc & 0xFF);
+    ch ^= (byte)(ch << 4);
+    crc = (crc >> 8) ^ ((uint16_t)ch << 8) ^ ((uint16_t)ch << 3) ^ ((uint16_t)ch >> 4);
+  }
+  out[0] = crc & 0xFF;
+  out[1] = crc >> 8;
+}
+
+void IRAM_ATTR RC522Fast::onIrq(void *arg) {
+  RC522Fast *self = (RC522Fast *)arg;
+  if (!self->armed_ || self->irqFired_) return;
+  self->irqMicros_ = micros();
+  self->irqFired_ = true;
+}
+
+void RC522Fast::begin(uint32_t armIntervalMs) {
+  armIntervalMs_ = armIntervalMs;
+  pinMode(irqPin_, INPUT_PULLUP);
+  writeReg(MFRC522::DivIEnReg, IRQ_PUSH_PULL);
+  attachInterruptArg(digitalPinToInterrupt(irqPin_), onIrq, this, FALLING);
+  arm();
+}
+
+// ---- SPI 存取：讀可以一次 CS 連續讀多個暫存器，寫則共用同一個 transaction ----
+void RC522Fast::writeReg(byte reg, byte value) {
+  SPI.beginTransaction(spi_);
+  digitalWrite(ssPin_, LOW);
+  SPI.transfer(reg);
+  SPI.transfer(value);
+  digitalWrite(ssPin_, HIGH);
+  SPI.endTransaction();
+}
+
+void RC522Fast::writeFifo(const byte *data, byte len) {
+  digitalWrite(ssPin_, LOW);
+  SPI.transfer(MFRC522::FIFODataReg);
+  for (byte i = 0; i < len; i++) SPI.transfer(data[i]);
+  digitalWrite(ssPin_, HIGH);
+}
+
+void RC522Fast::readRegs(const byte *regs, byte count, byte *out) {
+  if (count == 0) return;
+  SPI.beginTransaction(spi_);
+  digitalWrite(ssPin_, LOW);
+  SPI.transfer(0x80 | regs[0]);
+  for (byte i = 1; i < count; i++) out[i - 1] = SPI.transfer(0x80 | regs[i]);
+  out[count - 1] = SPI.transfer(0);
+  digitalWrite(ssPin_, HIGH);
+  SPI.endTransaction();
+}
+
+void RC522Fast::readFifo(byte *out, byte len) {
+  if (len == 0) return;
+  SPI.beginTransaction(spi_);
+  digitalWrite(ssPin_, LOW);
+  SPI.transfer(0x80 | MFRC522::FIFODataReg);
+  for (byte i = 1; i < len; i++) out[i - 1] = SPI.transfer(0x80 | MFRC522::FIFODataReg);
+  out[len - 1] = SPI.transfer(0);
+  digitalWrite(ssPin_, HIGH);
+  SPI.endTransaction();
+}
+
+// 送出一個 frame 並等 IRQ 腳（不輪詢 ComIrqReg），結束後一次讀回狀態
+bool RC522Fast::transceive(const byte *data, byte len, byte bitFraming, byte *back, byte *backLen, uint32_t timeoutUs) {
+  const byte seq[][2] = {
+    { MFRC522::ComIEnReg,    (byte)(IRQ_INV | RX_IEN | ERR_IEN | TIMER_IEN) },
+    { MFRC522::CommandReg,   MFRC522::PCD_Idle },
+    { MFRC522::ComIrqReg,    0x7F },
+    { MFRC522::FIFOLevelReg, 0x80 },
+  };
+  SPI.beginTransaction(spi_);
+  for (auto &w : seq) {
+    digitalWrite(ssPin_, LOW);
+    SPI.transfer(w[0]);
+    SPI.transfer(w[1]);
+    digitalWrite(ssPin_, HIGH);
+  }
+  writeFifo(data, len);
+  const byte start[][2] = {
+    { MFRC522::BitFramingReg, bitFraming },
+    { MFRC522::CommandReg,    MFRC522::PCD_Transceive },
+    { MFRC522::BitFramingReg, (byte)(0x80 | bitFraming) }, // StartSend
+  };
+  for (auto &w : start) {
+    digitalWrite(ssPin_, LOW);
+    SPI.transfer(w[0]);
+    SPI.transfer(w[1]);
+    digitalWrite(ssPin_, HIGH);
+  }
+  SPI.endTransaction();
+
+  uint32_t t0 = micros();
+  while (digitalRead(irqPin_) == HIGH) {
+    if (micros() - t0 > timeoutUs) return false;
+  }
+
+  static const byte statusRegs[] = { MFRC522::ComIrqReg, MFRC522::ErrorReg, MFRC522::FIFOLevelReg };
+  byte st[3];
+  readRegs(statusRegs, 3, st);
+  if (!(st[0] & RX_IRQ)) return false;              // timeout
+  if (st[1] & (ERR_FATAL | ERR_COLL)) return false; // 碰撞交給函式庫處理
+  if (st[2] > *backLen) return false;
+
+  *backLen = st[2];
+  readFifo(back, st[2]);
+  return true;
+}
+
+// 送 REQA 並只開 RxIRq：有卡回 ATQA 時 IRQ 腳才會拉低
+void RC522Fast::arm() {
+  const byte reqa = MFRC522::PICC_CMD_REQA;
+  irqFired_ = false;
+  lastArmMillis_ = millis();
+
+  writeReg(MFRC522::ComIEnReg, IRQ_INV | RX_IEN);
+  SPI.beginTransaction(spi_);
+  const byte seq[][2] = {
+    { MFRC522::CommandReg,    MFRC522::PCD_Idle },
+    { MFRC522::ComIrqReg,     0x7F },
+    { MFRC522::FIFOLevelReg,  0x80 },
+  };
+  for (auto &w : seq) {
+    digitalWrite(ssPin_, LOW);
+    SPI.transfer(w[0]);
+    SPI.transfer(w[1]);
+    digitalWrite(ssPin_, HIGH);
+  }
+  writeFifo(&reqa, 1);
+  SPI.endTransaction();
+
+  armed_ = true;
+  writeReg(MFRC522::BitFramingReg, 0x07);                 // REQA 只送 7 bits
+  writeReg(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  writeReg(MFRC522::BitFramingReg, 0x87);                 // StartSend
+}
+
+// anticollision + select，每一層 cascade 兩個 frame
+bool RC522Fast::readSerialFast() {
+  static const byte selCmd[] = {
+    MFRC522::PICC_CMD_SEL_CL1, MFRC522::PICC_CMD_SEL_CL2, MFRC522::PICC_CMD_SEL_CL3
+  };
+  MFRC522::Uid &uid = rfid_.uid;
+  uid.size = 0;
+
+  for (byte level = 0; level < 3; level++) {
+    byte anticoll[2] = { selCmd[level], 0x20 };
+    byte resp[5];
+    byte n = sizeof(resp);
+    if (!transceive(anticoll, 2, 0x00, resp, &n, PICC_TIMEOUT_US) || n != 5) return false;
+    if ((resp[0] ^ resp[1] ^ resp[2] ^ resp[3]) != resp[4]) return false; // BCC
+
+    byte select[9] = { selCmd[level], 0x70, resp[0], resp[1], resp[2], resp[3], resp[4] };
+    crcA(select, 7, &select[7]);
+    byte sak[3];
+    n = sizeof(sak);
+    if (!transceive(select, 9, 0x00, sak, &n, PICC_TIMEOUT_US) || n != 3) return false;
+    byte crc[2];
+    crcA(sak, 1, crc);
+    if (crc[0] != sak[1] || crc[1] != sak[2]) return false;
+
+    bool more = sak[0] & 0x04;
+    if (more) {
+      if (resp[0] != MFRC522::PICC_CMD_CT) return false;
+      memcpy(&uid.uidByte[uid.size], &resp[1], 3);
+      uid.size += 3;
+    } else {
+      memcpy(&uid.uidByte[uid.size], resp, 4);
+      uid.size += 4;
+      uid.sak = sak[0];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RC522Fast::poll() {
+  if (!irqFired_) {
+    if (millis() - lastArmMillis_ >= armIntervalMs_) arm();
+    return false;
+  }
+  armed_ = false;
+  uint32_t t0 = irqMicros_;
+
+  bool ok = readSerialFast();
+  if (!ok) {
+    // 碰撞或訊號不好：用函式庫完整流程再試一次
+    timing_.fallbacks++;
+    ok = rfid_.PICC_ReadCardSerial() ||
+         (rfid_.PICC_IsNewCardPresent() && rfid_.PICC_ReadCardSerial());
+  }
+  if (!ok) {
+    arm();
+    return false;
+  }
+
+  lastLatencyUs_ = micros() - t0;
+  timing_.add(lastLatencyUs_);
+  writeReg(MFRC522::ComIEnReg, IRQ_INV); // 交給呼叫端 HaltA，下一輪 poll() 再重新 arm
+  irqFired_ = false;
+  lastArmMillis_ = millis();
+  return true;
+}
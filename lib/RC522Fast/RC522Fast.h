@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <MFRC522.h>
+
+// === RC522 快速讀卡模式 ===
+// - SPI 跑在 RC522 上限 10 MHz（MFRC522 函式庫本身的呼叫預設 4 MHz，
+//   可在 build_flags 加 -DMFRC522_SPICLOCK=10000000u 一起拉高）
+// - 用 IRQ 腳判斷卡片出現：定期送一次 REQA 並只開 RxIRq，
+//   有卡回 ATQA 才會拉低 IRQ，MCU 不用一直輪詢暫存器
+// - anticollision / select 自己做：狀態暫存器一次 CS 連續讀完，
+//   CRC_A 用軟體算，省掉 CRC 協處理器的來回
+// - 碰到多卡碰撞等少見情況，退回 MFRC522::PICC_ReadCardSerial()
+
+const uint32_t RC522_SPI_HZ = 10000000; // RC522 datasheet 上限
+
+struct RC522Timing {
+  uint32_t count = 0;
+  uint32_t minUs = 0;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+  uint32_t fallbacks = 0; // 走 MFRC522 函式庫慢速路徑的次數
+
+  void add(uint32_t us);
+  uint32_t avgUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+};
+
+class RC522Fast {
+public:
+  RC522Fast(MFRC522 &rfid, uint8_t ssPin, uint8_t irqPin)
+    : rfid_(rfid), ssPin_(ssPin), irqPin_(irqPin) {}
+
+  // SPI.begin() 與 rfid.PCD_Init() 需先呼叫
+  void begin(uint32_t armIntervalMs = 50);
+
+  // 放在 loop()：必要時重新送 REQA；讀到卡回傳 true，UID 在 rfid.uid
+  bool poll();
+
+  // 最近一次 IRQ -> UID 的延遲統計
+  const RC522Timing &timing() const { return timing_; }
+  void resetTiming() { timing_ = RC522Timing(); }
+  uint32_t lastLatencyUs() const { return lastLatencyUs_; }
+
+private:
+  static void IRAM_ATTR onIrq(void *arg);
+
+  void arm();
+  bool readSerialFast();
+  bool transceive(const byte *data, byte len, byte bitFraming, byte *back, byte *backLen, uint32_t timeoutUs);
+
+  void writeReg(byte reg, byte value);
+  void writeFifo(const byte *data, byte len);
+  void readRegs(const byte *regs, byte count, byte *out);
+  void readFifo(byte *out, byte len);
+
+  MFRC522 &rfid_;
+  uint8_t ssPin_;
+  uint8_t irqPin_;
+  SPISettings spi_ = SPISettings(RC522_SPI_HZ, MSBFIRST, SPI_MODE0);
+
+  volatile bool armed_ = false;
+  volatile bool irqFired_ = false;
+  volatile uint32_t irqMicros_ = 0;
+
+  uint32_t armIntervalMs_ = 50;
+  uint32_t lastArmMillis_ = 0;
+
+  RC522Timing timing_;
+  uint32_t lastLatencyUs_ = 0;
+};
@@ -0,0 +1,75 @@
+#include "SpeedPid.h"
+
+// SpeedLoop 預設增益（Q8，100 Hz），連同量測低通的延遲一起調：
+// kd 大一點補低通的相位落後，ki 小一點避免起步時積分把輪速推過頭
+static const int32_t KP = 60;
+static const int32_t KI = 2;
+static const int32_t KD = 200;
+
+static int32_t clamp32(int64_t v, int32_t lo, int32_t hi) {
+  if (v < lo) return lo;
+  if (v > hi) return hi;
+  return (int32_t)v;
+}
+
+void SpeedPid::reset() {
+  integral_ = 0;
+  lastMeasured_ = 0;
+  primed_ = false;
+  saturated_ = false;
+}
+
+int32_t SpeedPid::update(int32_t setpoint, int32_t measured) {
+  int32_t error = setpoint - measured;
+  int32_t limitQ8 = limit_ * ONE;
+
+  int64_t p = (int64_t)gains_.kp * error;
+  int64_t ff = (int64_t)gains_.kff * setpoint;
+  int64_t d = primed_ ? -(int64_t)gains_.kd * (measured - lastMeasured_) : 0;
+  lastMeasured_ = measured;
+  primed_ = true;
+
+  // 先試算加上這次積分後的輸出，飽和且誤差同方向就不積分
+  int32_t nextIntegral = clamp32((int64_t)integral_ + (int64_t)gains_.ki * error, -limitQ8, limitQ8);
+  int64_t out = ff + p + d + nextIntegral;
+  bool high = out > limitQ8;
+  bool low = out < -limitQ8;
+  if (!((high && error > 0) || (low && error < 0))) {
+    integral_ = nextIntegral;
+  }
+
+  out = ff + p + d + integral_;
+  saturated_ = out > limitQ8 || out < -limitQ8;
+  int32_t q8 = clamp32(out, -limitQ8, limitQ8);
+  // 四捨五入回整數 duty
+  return q8 >= 0 ? (q8 + ONE / 2) / ONE : -((-q8 + ONE / 2) / ONE);
+}
+
+PidGains SpeedLoop::defaultGains(int32_t maxDuty, int32_t maxSpeedCps) {
+  return { KP, KI, KD, SpeedPid::ONE * maxDuty / maxSpeedCps };
+}
+
+void SpeedLoop::reset() {
+  pid_.reset();
+  deadUs_ = 0;
+}
+
+void SpeedLoop::measure(int32_t deltaCounts, uint32_t elapsedUs) {
+  lastDelta_ = deltaCounts;
+  lastElapsedUs_ = elapsedUs;
+  if (elapsedUs == 0) return;
+  int32_t raw = (int32_t)((int64_t)deltaCounts * 1000000 / elapsedUs);
+  measured_ += (raw - measured_) / 4; // 一階低通
+}
+
+int32_t SpeedLoop::update(int32_t setpointCps) {
+  int32_t duty = pid_.update(setpointCps, measured_);
+  if (setpointCps == 0 || lastDelta_ != 0) {
+    deadUs_ = 0;
+    return duty;
+  }
+  if (deadUs_ < encoderTimeoutUs_) deadUs_ += lastElapsedUs_;
+  int64_t expected = (int64_t)(setpointCps < 0 ? -setpointCps : setpointCps) * deadUs_ / 1000000;
+  if (deadUs_ >= encoderTimeoutUs_ && expected >= MIN_EXPECTED_COUNTS) fault_ = true;
+  return duty;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+// === 定點數速度 PID ===
+// 以固定頻率呼叫 update()，增益為 Q8（256 = 1.0），週期已併入 ki / kd。
+// - 前饋 kff：duty ≈ kff * setpoint，PID 只需補負載與電壓差
+// - D 項對量測值微分，改變目標時不會突跳
+// - Anti-windup：輸出飽和且誤差仍朝飽和方向時不累積積分，另外限制積分上限
+// SpeedLoop 把編碼器計數 -> 低通輪速 -> PID 包在一起，firmware 的 speedTask 和
+// native 測試呼叫同一份程式，另外負責偵測編碼器沒有回授。
+// 不依賴 Arduino，可直接在 native 下跑。
+
+struct PidGains {
+  int32_t kp;
+  int32_t ki;
+  int32_t kd;
+  int32_t kff;
+};
+
+class SpeedPid {
+public:
+  static const int32_t ONE = 256; // Q8 的 1.0
+
+  void setGains(const PidGains &g) { gains_ = g; }
+  const PidGains &gains() const { return gains_; }
+  void setOutputLimit(int32_t limit) { limit_ = limit > 0 ? limit : 0; }
+  void reset();
+
+  // setpoint / measured 同單位（例如 counts/s），回傳 -limit..limit
+  int32_t update(int32_t setpoint, int32_t measured);
+
+  int32_t integral() const { return integral_; }
+  bool saturated() const { return saturated_; }
+
+private:
+  PidGains gains_ = { 0, 0, 0, 0 };
+  int32_t limit_ = 255;
+  int32_t integral_ = 0;   // 誤差累積（已乘 ki，Q8）
+  int32_t lastMeasured_ = 0;
+  bool primed_ = false;
+  bool saturated_ = false;
+};
+
+// === 閉迴路速度控制 ===
+// 每個週期先 measure()（這週期的編碼器計數與實際經過時間），再 update() 算 duty。
+// 編碼器失效保護：目標不為 0 卻連續 encoderTimeoutUs 沒有任何計數，而且照目標這段時間
+// 至少該收到 MIN_EXPECTED_COUNTS 個計數（極低速時不誤判），視為沒裝或斷線的編碼器。
+// 不等輸出飽和：積分爬到上限要好幾秒，那時輕推搖桿早就變成全速。
+// encoderFault() 鎖定為 true，呼叫端改回開迴路直接輸出 duty。
+class SpeedLoop {
+public:
+  static const int32_t MIN_EXPECTED_COUNTS = 8;
+
+  // 預設增益（Q8）；前饋讓 maxDuty 對應 maxSpeedCps
+  static PidGains defaultGains(int32_t maxDuty, int32_t maxSpeedCps);
+
+  void setGains(const PidGains &g) { pid_.setGains(g); }
+  void setOutputLimit(int32_t limit) { pid_.setOutputLimit(limit); }
+  void setEncoderTimeout(uint32_t us) { encoderTimeoutUs_ = us; }
+
+  // 目標歸零時呼叫：清掉 PID 狀態（量測值照常更新）
+  void reset();
+
+  void measure(int32_t deltaCounts, uint32_t elapsedUs);
+  int32_t update(int32_t setpointCps);
+
+  int32_t measuredCps() const { return measured_; }
+  bool encoderFault() const { return fault_; }
+  uint32_t deadUs() const { return deadUs_; }
+  const SpeedPid &pid() const { return pid_; }
+
+private:
+  SpeedPid pid_;
+  int32_t measured_ = 0;      // 一階低通後的輪速（counts/s）
+  int32_t lastDelta_ = 0;
+  uint32_t lastElapsedUs_ = 0;
+  uint32_t encoderTimeoutUs_ = 200000;
+  uint32_t deadUs_ = 0;       // 目標不為 0 且沒有計數的持續時間
+  bool fault_ = false;
+};
@@ -0,0 +1,107 @@
+#include "Trajectory.h"
+
+#include <string.h>
+
+static_assert(sizeof(Keyframe) == 8, "Keyframe must stay 8 bytes on the wire");
+static_assert(sizeof(TrajectoryHeader) == 8, "TrajectoryHeader must stay 8 bytes on the wire");
+
+static bool inRange(int16_t v, int16_t maxValue) {
+  return v >= -maxValue && v <= maxValue;
+}
+
+bool Trajectory::validate(const uint8_t *data, size_t len, int16_t maxValue) {
+  if (!data || len < sizeof(TrajectoryHeader)) return false;
+
+  TrajectoryHeader h;
+  memcpy(&h, data, sizeof(h));
+  if (h.magic != TRAJ_MAGIC || h.count > MAX_KEYFRAMES) return false;
+  if (len != sizeof(h) + (size_t)h.count * sizeof(Keyframe)) return false;
+
+  const uint8_t *p = data + sizeof(h);
+  uint32_t lastT = 0;
+  for (uint16_t i = 0; i < h.count; i++) {
+    Keyframe k;
+    memcpy(&k, p + i * sizeof(Keyframe), sizeof(k));
+    if (i > 0 && k.tMs <= lastT) return false;
+    if (!inRange(k.steer, maxValue) || !inRange(k.throttle, maxValue)) return false;
+    lastT = k.tMs;
+  }
+  return true;
+}
+
+bool Trajectory::load(const uint8_t *data, size_t len, int16_t maxValue) {
+  if (!validate(data, len, maxValue)) return false;
+
+  TrajectoryHeader h;
+  memcpy(&h, data, sizeof(h));
+  memcpy(image_.frames, data + sizeof(h), (size_t)h.count * sizeof(Keyframe));
+  image_.header.count = h.count;
+  cursor_ = 0;
+  return true;
+}
+
+void Trajectory::clear() {
+  image_.header.count = 0;
+  cursor_ = 0;
+}
+
+bool Trajectory::append(uint32_t tMs, int16_t steer, int16_t throttle) {
+  uint16_t &n = image_.header.count;
+  Keyframe *frames = image_.frames;
+  if (n >= MAX_KEYFRAMES) return false;
+  if (n > 0 && tMs <= frames[n - 1].tMs) {
+    // 同一毫秒內的第二筆：以最新的值為準
+    if (tMs == frames[n - 1].tMs) {
+      frames[n - 1].steer = steer;
+      frames[n - 1].throttle = throttle;
+      return true;
+    }
+    return false;
+  }
+  frames[n++] = { tMs, steer, throttle };
+  return true;
+}
+
+bool Trajectory::record(uint32_t tMs, int16_t steer, int16_t throttle) {
+  uint16_t n = count();
+  if (n == 0) return append(tMs, steer, throttle);
+  Keyframe last = image_.frames[n - 1];
+  if (tMs <= last.tMs) return append(tMs, steer, throttle);
+  if (steer == last.steer && throttle == last.throttle) return true;
+  if (MAX_KEYFRAMES - n < 2) return false;
+  if (tMs - 1 > last.tMs) append(tMs - 1, last.steer, last.throttle);
+  return append(tMs, steer, throttle);
+}
+
+static int16_t lerp16(int16_t a, int16_t b, uint32_t num, uint32_t den) {
+  return (int16_t)(a + (int32_t)((int64_t)(b - a) * num / den));
+}
+
+bool Trajectory::sample(uint32_t tMs, int16_t &steer, int16_t &throttle) const {
+  uint16_t n = count();
+  const Keyframe *frames = image_.frames;
+  if (n == 0 || tMs > frames[n - 1].tMs) return false;
+
+  if (tMs <= frames[0].tMs) {
+    steer = frames[0].steer;
+    throttle = frames[0].throttle;
+    return true;
+  }
+
+  // 循序播放時 cursor_ 只會往後移
+  if (cursor_ >= n || frames[cursor_].tMs > tMs) cursor_ = 0;
+  while (cursor_ + 1 < n && frames[cursor_ + 1].tMs <= tMs) cursor_++;
+
+  const Keyframe &a = frames[cursor_];
+  if (cursor_ + 1 >= n) {
+    steer = a.steer;
+    throttle = a.throttle;
+    return true;
+  }
+  const Keyframe &b = frames[cursor_ + 1];
+  uint32_t num = tMs - a.tMs;
+  uint32_t den = b.tMs - a.tMs;
+  steer = lerp16(a.steer, b.steer, num, den);
+  throttle = lerp16(a.throttle, b.throttle, num, den);
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// === AUTO 模式軌跡 ===
+// 二進位格式（little endian）：
+//   header  : magic "TRJ1"(4) + count(uint16) + reserved(uint16)
+//   keyframe: tMs(uint32) + steer(int16) + throttle(int16)，tMs 必須遞增
+// sample() 在相鄰 keyframe 間做整數線性內插；依序往後取樣時為 O(1)。
+// 錄製時用 record()：搖桿只在 frame 進來時取值，兩個 frame 之間要維持前一個值，
+// 所以值改變時先在 tMs - 1 補一個 hold keyframe，播放才不會變成斜坡。
+// 記憶體內就是序列化格式（header 與 keyframe 連續放），data() 可直接寫進 NVS，不用另外的緩衝。
+// 不依賴 Arduino，存放（NVS）與上傳由呼叫端處理。
+
+struct Keyframe {
+  uint32_t tMs;
+  int16_t steer;
+  int16_t throttle;
+};
+
+struct TrajectoryHeader {
+  uint32_t magic;
+  uint16_t count;
+  uint16_t reserved;
+};
+
+const uint32_t TRAJ_MAGIC = 0x314A5254; // "TRJ1"
+
+class Trajectory {
+public:
+  static const uint16_t MAX_KEYFRAMES = 512;
+  static const size_t MAX_BYTES = sizeof(TrajectoryHeader) + MAX_KEYFRAMES * sizeof(Keyframe);
+
+  // 格式錯誤（magic、長度、時間未遞增、超過上限、steer / throttle 超出 ±maxValue）
+  // 時回傳 false，原內容不變
+  bool load(const uint8_t *data, size_t len, int16_t maxValue);
+  static bool validate(const uint8_t *data, size_t len, int16_t maxValue);
+  const uint8_t *data() const { return reinterpret_cast<const uint8_t *>(&image_); }
+  size_t serializedSize() const { return sizeof(TrajectoryHeader) + count() * sizeof(Keyframe); }
+
+  // 超過最後一個 keyframe 時回傳 false
+  bool sample(uint32_t tMs, int16_t &steer, int16_t &throttle) const;
+
+  // 錄製用。append() 原樣加入；record() 值沒變就不記，改變時補 hold keyframe，
+  // 最多用掉 2 格，空間不夠時回傳 false
+  void clear();
+  bool append(uint32_t tMs, int16_t steer, int16_t throttle);
+  bool record(uint32_t tMs, int16_t steer, int16_t throttle);
+
+  uint16_t count() const { return image_.header.count; }
+  bool empty() const { return count() == 0; }
+  uint32_t durationMs() const { return empty() ? 0 : image_.frames[count() - 1].tMs; }
+
+private:
+  struct Image {
+    TrajectoryHeader header;
+    Keyframe frames[MAX_KEYFRAMES];
+  };
+  static_assert(sizeof(Image) == MAX_BYTES, "no padding between header and keyframes");
+
+  Image image_ = { { TRAJ_MAGIC, 0, 0 }, {} };
+  mutable uint16_t cursor_ = 0; // 上次取樣的區段，循序播放時不用重新搜尋
+};
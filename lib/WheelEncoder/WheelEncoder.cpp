@@ -0,0 +1,80 @@
+#include "WheelEncoder.h"
+
+#include <soc/soc_caps.h>
+#if SOC_PCNT_SUPPORTED
+#include <driver/pcnt.h>
+#endif
+
+void IRAM_ATTR WheelEncoder::onEdge(void *arg) {
+  WheelEncoder *self = (WheelEncoder *)arg;
+  self->isrCount_ += digitalRead(self->pinB_) ? -1 : 1;
+}
+
+#if SOC_PCNT_SUPPORTED
+void IRAM_ATTR WheelEncoder::onPcntLimit(void *arg) {
+  WheelEncoder *self = (WheelEncoder *)arg;
+  uint32_t status = 0;
+  pcnt_get_event_status((pcnt_unit_t)self->unit_, &status);
+  if (status & PCNT_EVT_H_LIM) self->pcntBase_ += PCNT_LIMIT;
+  if (status & PCNT_EVT_L_LIM) self->pcntBase_ -= PCNT_LIMIT;
+}
+
+// 累加器 + 計數器；讀的中間遇到溢位中斷就重讀
+int32_t WheelEncoder::pcntPosition() const {
+  int32_t base;
+  int16_t count = 0;
+  do {
+    base = pcntBase_;
+    pcnt_get_counter_value((pcnt_unit_t)unit_, &count);
+  } while (base != pcntBase_);
+  return base + count;
+}
+#endif
+
+void WheelEncoder::begin() {
+  pinMode(pinA_, INPUT_PULLUP);
+  pinMode(pinB_, INPUT_PULLUP);
+
+#if SOC_PCNT_SUPPORTED
+  pcnt_config_t cfg = {};
+  cfg.pulse_gpio_num = pinA_;
+  cfg.ctrl_gpio_num = pinB_;
+  cfg.channel = PCNT_CHANNEL_0;
+  cfg.unit = (pcnt_unit_t)unit_;
+  cfg.pos_mode = PCNT_COUNT_INC;
+  cfg.neg_mode = PCNT_COUNT_DIS;
+  cfg.lctrl_mode = PCNT_MODE_KEEP;
+  cfg.hctrl_mode = PCNT_MODE_REVERSE; // B 為 HIGH 時反轉，與中斷版方向一致
+  cfg.counter_h_lim = PCNT_LIMIT;
+  cfg.counter_l_lim = -PCNT_LIMIT;
+  if (pcnt_unit_config(&cfg) == ESP_OK) {
+    pcnt_set_filter_value(cfg.unit, 100); // 濾掉 < 100 個 APB clock 的雜訊
+    pcnt_filter_enable(cfg.unit);
+    pcnt_event_enable(cfg.unit, PCNT_EVT_H_LIM);
+    pcnt_event_enable(cfg.unit, PCNT_EVT_L_LIM);
+    pcnt_isr_service_install(0); // 已安裝時回傳 ESP_ERR_INVALID_STATE，可忽略
+    pcnt_isr_handler_add(cfg.unit, onPcntLimit, this);
+    pcnt_counter_pause(cfg.unit);
+    pcnt_counter_clear(cfg.unit);
+    pcntBase_ = 0;
+    lastCount_ = 0;
+    pcnt_counter_resume(cfg.unit);
+    pcnt_ = true;
+    return;
+  }
+#endif
+
+  attachInterruptArg(digitalPinToInterrupt(pinA_), onEdge, this, RISING);
+}
+
+int32_t WheelEncoder::readDelta() {
+#if SOC_PCNT_SUPPORTED
+  int32_t now = pcnt_ ? pcntPosition() : isrCount_;
+#else
+  int32_t now = isrCount_;
+#endif
+  int32_t delta = now - lastCount_;
+  lastCount_ = now;
+  total_ += delta;
+  return delta;
+}
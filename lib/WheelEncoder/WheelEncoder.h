@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// === 輪速編碼器 ===
+// 晶片有 PCNT 時用硬體計數（ESP32 / S2 / S3），
+// 沒有時（ESP32-C3）改用 A 相上升緣中斷、B 相判斷方向。
+// 控制迴圈固定週期呼叫 readDelta() 取得這段時間的計數。
+// PCNT 計數器不清零（讀和清之間的脈衝會掉），改成累加器：
+// 計到 ±PCNT_LIMIT 時硬體歸零、溢位中斷把 ±PCNT_LIMIT 加進 pcntBase_，
+// readDelta() 用 pcntBase_ + 計數器值 與上次的差。
+
+class WheelEncoder {
+public:
+  WheelEncoder(uint8_t pinA, uint8_t pinB, uint8_t pcntUnit = 0)
+    : pinA_(pinA), pinB_(pinB), unit_(pcntUnit) {}
+
+  void begin();
+  int32_t readDelta();
+  int32_t total() const { return total_; }
+  bool usingPcnt() const { return pcnt_; }
+
+private:
+  static const int16_t PCNT_LIMIT = 16384;
+
+  static void IRAM_ATTR onEdge(void *arg);
+  static void IRAM_ATTR onPcntLimit(void *arg);
+  int32_t pcntPosition() const;
+
+  uint8_t pinA_;
+  uint8_t pinB_;
+  uint8_t unit_;
+  bool pcnt_ = false;
+  volatile int32_t isrCount_ = 0;
+  volatile int32_t pcntBase_ = 0;
+  int32_t lastCount_ = 0;     // 上次 readDelta() 的位置（PCNT 或中斷計數）
+  int32_t total_ = 0;
+};
@@ -0,0 +1,144 @@
+#include "WiFiLink.h"
+
+#include <esp_wifi.h>
+
+static const char *CACHE_KEY = "wifi";
+
+bool WiFiLink::loadCache() {
+  // 舊版快取還含密碼與 IP，大小不同當作沒有；連上後 saveCache() 會整筆覆蓋
+  if (prefs_.getBytesLength(CACHE_KEY) != sizeof(cache_)) return false;
+  prefs_.getBytes(CACHE_KEY, &cache_, sizeof(cache_));
+  cache_.ssid[sizeof(cache_.ssid) - 1] = '\0';
+  return cache_.ssid[0] != '\0' && cache_.channel != 0;
+}
+
+// 只有內容變了才寫，避免每次開機都磨 flash
+void WiFiLink::saveCache() {
+  WiFiCache now = {};
+  strncpy(now.ssid, WiFi.SSID().c_str(), sizeof(now.ssid) - 1);
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid) memcpy(now.bssid, bssid, sizeof(now.bssid));
+  now.channel = WiFi.channel();
+
+  if (cached_ && memcmp(&now, &cache_, sizeof(now)) == 0) return;
+  cache_ = now;
+  cached_ = cache_.ssid[0] != '\0' && cache_.channel != 0;
+  prefs_.putBytes(CACHE_KEY, &cache_, sizeof(cache_));
+}
+
+// 把快取的 channel + BSSID 套進 driver 目前的 STA 設定；pinned = false 時清掉，回到全頻道掃描。
+// SSID / 密碼沿用 driver 存的，driver 的 SSID 和快取不同時不套用。
+// 設定沒變就不呼叫 esp_wifi_set_config()（driver 會把設定寫進 flash）。
+bool WiFiLink::setTarget(bool pinned) {
+  wifi_config_t conf;
+  if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return false;
+  if (pinned && strncmp((const char *)conf.sta.ssid, cache_.ssid, sizeof(conf.sta.ssid)) != 0) return false;
+
+  uint8_t channel = pinned ? cache_.channel : 0;
+  bool same = conf.sta.bssid_set == pinned && conf.sta.channel == channel &&
+              (!pinned || memcmp(conf.sta.bssid, cache_.bssid, sizeof(conf.sta.bssid)) == 0);
+  if (same) return true;
+  conf.sta.bssid_set = pinned;
+  conf.sta.channel = channel;
+  if (pinned) memcpy(conf.sta.bssid, cache_.bssid, sizeof(conf.sta.bssid));
+  return esp_wifi_set_config(WIFI_IF_STA, &conf) == ESP_OK;
+}
+
+bool WiFiLink::fastJoin() {
+  cached_ = loadCache();
+  if (!cached_) return false;
+
+  uint32_t start = millis();
+  WiFi.mode(WIFI_STA);
+  if (!setTarget(true)) return false;
+  WiFi.begin();
+  while (WiFi.status() != WL_CONNECTED && millis() - start < FAST_JOIN_TIMEOUT_MS) {
+    delay(10);
+  }
+  if (WiFi.status() == WL_CONNECTED) {
+    stats_.bootJoinMs = millis() - start;
+    stats_.fastJoins++;
+    return true;
+  }
+
+  // 快取失效：清掉 BSSID / channel，交給呼叫端走一般流程
+  WiFi.disconnect();
+  setTarget(false);
+  return false;
+}
+
+void WiFiLink::begin() {
+  saveCache();
+  up_ = WiFi.status() == WL_CONNECTED;
+  // 自己管重連：內建的 auto reconnect 每次都全頻道掃描
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t) { onEvent(event); });
+}
+
+// 在 WiFi 事件 task 執行，只記下時間點。
+// 只有原本連著（up_）才算掉線：startAttempt() 自己的 WiFi.disconnect() 也會產生
+// STA_DISCONNECTED，那時 up_ 已經是 false，不會重複通知
+void WiFiLink::onEvent(arduino_event_id_t event) {
+  if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP) {
+    bool wasUp = up_;
+    up_ = false;
+    if (wasUp) {
+      lostMs_ = millis();
+      lostPending_ = true;
+      if (linkLost_) linkLost_();
+    }
+  } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    gotIpMs_ = millis();
+    gotIpPending_ = true;
+    up_ = true;
+  }
+}
+
+void WiFiLink::startAttempt(uint32_t now) {
+  attemptStartMs_ = now;
+  attempts_++;
+  WiFi.disconnect();
+  pinned_ = cached_ && attempts_ <= FAST_ATTEMPTS && setTarget(true);
+  if (!pinned_) setTarget(false);
+  WiFi.begin();
+}
+
+void WiFiLink::service() {
+  uint32_t now = millis();
+
+  if (lostPending_) {
+    lostPending_ = false;
+    outageStartMs_ = lostMs_;
+    reconnecting_ = true;
+    attempts_ = 0;
+    startAttempt(now);
+  }
+
+  if (gotIpPending_) {
+    gotIpPending_ = false;
+    if (reconnecting_) {
+      uint32_t ms = gotIpMs_ - outageStartMs_;
+      stats_.reconnects++;
+      stats_.lastReconnectMs = ms;
+      if (ms > stats_.maxReconnectMs) stats_.maxReconnectMs = ms;
+      stats_.totalOutageMs += ms;
+      if (pinned_) stats_.fastJoins++;
+      reconnecting_ = false;
+      saveCache(); // 可能換了 AP / channel
+    }
+    // 重連會重設省電模式
+    WiFi.setSleep(powerSave_);
+  }
+
+  if (reconnecting_ && !up_) {
+    uint32_t timeout = ATTEMPT_TIMEOUT_MS;
+    if (attempts_ <= FAST_ATTEMPTS) timeout = FAST_JOIN_TIMEOUT_MS;
+    if (now - attemptStartMs_ >= timeout) startAttempt(now);
+  }
+}
+
+void WiFiLink::setPowerSave(bool enabled) {
+  if (enabled == powerSave_) return;
+  powerSave_ = enabled;
+  WiFi.setSleep(enabled);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+
+// === WiFi 快速重連 ===
+// 連上後只把 AP 的 BSSID / channel（和對應的 SSID）存進 NVS；密碼留在 WiFi driver
+// 自己存的設定裡，不另外複製。下次開機或斷線時把 channel + BSSID 套進 driver 的設定再
+// WiFi.begin()，省掉全頻道掃描；IP 一律走 DHCP，不會把過期的租約當成靜態 IP 用。
+// 快速加入失敗幾次後清掉 BSSID / channel 改用一般掃描，避免 AP 換 channel 時卡住。
+// 斷線後在背景重連：WiFi 事件只記時間，service() 在 loop 裡決定何時重試。
+// 重試前自己呼叫的 WiFi.disconnect() 不算斷線，onLinkLost() 只在真的掉線時呼叫。
+
+struct WiFiCache {
+  char ssid[33];    // 只用來確認 driver 目前設定的是同一個網路
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+struct WiFiLinkStats {
+  uint32_t bootJoinMs = 0;        // 開機快速加入花的時間（0 = 沒用到快取）
+  uint32_t reconnects = 0;
+  uint32_t fastJoins = 0;         // 靠快取（channel + BSSID）成功的次數
+  uint32_t lastReconnectMs = 0;   // 斷線 -> 拿到 IP
+  uint32_t maxReconnectMs = 0;
+  uint32_t totalOutageMs = 0;
+};
+
+class WiFiLink {
+public:
+  static const uint32_t FAST_JOIN_TIMEOUT_MS = 1500;
+  static const uint32_t ATTEMPT_TIMEOUT_MS = 5000;
+  static const uint8_t FAST_ATTEMPTS = 2;     // 之後改用全頻道掃描
+
+  typedef void (*LinkLostFn)();
+
+  explicit WiFiLink(Preferences &prefs) : prefs_(prefs) {}
+
+  // 開機用：有快取就試一次快速加入，阻塞最多 FAST_JOIN_TIMEOUT_MS
+  bool fastJoin();
+  // 連上後呼叫：記住目前的 AP 與 IP，並接手斷線重連
+  void begin();
+  // loop 裡週期呼叫
+  void service();
+  // 已連線時掉線（在 WiFi 事件 task 呼叫，不含自己重試時的 disconnect）
+  void onLinkLost(LinkLostFn fn) { linkLost_ = fn; }
+
+  // 有駕駛連線時關掉 modem 省電，降低封包延遲
+  void setPowerSave(bool enabled);
+  bool powerSave() const { return powerSave_; }
+
+  bool connected() const { return up_; }
+  bool hasCache() const { return cached_; }
+  const WiFiLinkStats &stats() const { return stats_; }
+
+private:
+  bool loadCache();
+  void saveCache();
+  bool setTarget(bool pinned);
+  void startAttempt(uint32_t now);
+  void onEvent(arduino_event_id_t event);
+
+  Preferences &prefs_;
+  WiFiCache cache_ = {};
+  bool cached_ = false;
+  bool powerSave_ = true;
+  WiFiLinkStats stats_;
+  LinkLostFn linkLost_ = nullptr;
+
+  volatile bool up_ = false;
+  volatile bool lostPending_ = false;   // 由 WiFi 事件 task 設定
+  volatile bool gotIpPending_ = false;
+  volatile uint32_t lostMs_ = 0;
+  volatile uint32_t gotIpMs_ = 0;
+
+  bool reconnecting_ = false;
+  uint32_t outageStartMs_ = 0;
+  uint32_t attemptStartMs_ = 0;
+  uint8_t attempts_ = 0;
+  bool pinned_ = false;   // 這次嘗試有指定 channel + BSSID
+};
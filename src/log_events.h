@@ -0,0 +1,48 @@
+#pragma once
+
+#include <BinLog.h>
+
+// === Log 事件表 ===
+// X(id, 格式字串)：參數最多 3 個，格式一律用 %ld。
+// 只能往後加，不要改順序（tools/binlog_decode.py 依出現順序編號）。
+#define LOG_EVENTS(X) \
+  X(EV_BOOT,           "boot") \
+  X(EV_WS_CONNECT,     "ws client %ld connected") \
+  X(EV_WS_DISCONNECT,  "ws client %ld disconnected") \
+  X(EV_WS_RECEIVED,    "ws rx client=%ld len=%ld") \
+  X(EV_JSON_ERROR,     "JSON parse error code=%ld len=%ld") \
+  X(EV_JOYSTICK,       "Joystick received: throttle=%ld steer=%ld") \
+  X(EV_MODE,           "Mode: %ld (0=AUTO 1=MANUAL)") \
+  X(EV_EMERGENCY_STOP, "EMERGENCY STOP source=%ld latency=%ld us") \
+  X(EV_RAMP,           "Ramping: currentA=%ld currentB=%ld") \
+  X(EV_TARGET,         "Target: targetA=%ld targetB=%ld") \
+  X(EV_ESTOP_CLEARED,  "emergency stop cleared") \
+  X(EV_AUTO_START,     "AUTO start: %ld keyframes, %ld ms") \
+  X(EV_AUTO_STOP,      "AUTO stop reason=%ld (0=done 1=override 2=estop 3=cmd)") \
+  X(EV_AUTO_EMPTY,     "AUTO: no trajectory stored") \
+  X(EV_TRAJ_SAVED,     "trajectory saved: %ld keyframes, %ld bytes") \
+  X(EV_TRAJ_REJECTED,  "trajectory rejected: %ld bytes") \
+  X(EV_REC_START,      "recording started") \
+  X(EV_REC_STOP,       "recording stopped: %ld keyframes") \
+  X(EV_WIFI_FAST_JOIN, "WiFi fast join: %ld ms on channel %ld") \
+  X(EV_WIFI_RECONNECTED, "WiFi reconnected after %ld ms on channel %ld") \
+  X(EV_PARAMS_UPDATED, "params updated: mask=%ld generation=%ld") \
+  X(EV_PARAMS_REJECTED, "params rejected: %ld entries, bad index %ld") \
+  X(EV_LOW_HEAP,       "low heap: %ld bytes free, largest block %ld") \
+  X(EV_POWER_STATE,    "power state %ld (0=active 1=idle 2=parked), cpu %ld MHz") \
+  X(EV_POWER_PM_FAILED, "esp_pm_configure failed: err %ld, light sleep %ld, fallback %ld") \
+  X(EV_SPEED_ENCODER_FAULT, "no encoder counts at setpoint %ld cps (duty %ld), speed loop now open") \
+  X(EV_TRAJ_SAVE_FAILED, "trajectory save failed: wrote %ld of %ld bytes") \
+  X(EV_CMD_TIMEOUT,    "no command for %ld ms, stopping")
+
+#define LOG_EVENT_ENUM_(id, fmt) id,
+#define LOG_EVENT_FMT_(id, fmt) fmt,
+
+enum LogEvent : uint16_t {
+  LOG_EVENTS(LOG_EVENT_ENUM_)
+  LOG_EVENT_COUNT
+};
+
+static const char *const logFormats[] = {
+  LOG_EVENTS(LOG_EVENT_FMT_)
+};
@@ -6,12 +6,62 @@
 #include <ESPAsyncWebServer.h>
 #include <ESPAsyncWiFiManager.h>
 #include <DNSServer.h>
+#include <Preferences.h>
+#include <atomic>
+#include <CoopScheduler.h>
+#include <SpeedPid.h>
+#include <WheelEncoder.h>
+#include <Trajectory.h>
+#include <WiFiLink.h>
+#include <ParamRegistry.h>
+#include <IdlePower.h>
+#include <EmergencyStop.h>
+#include <LatencyStats.h>
+#include <CommandPath.h>
+#if CONFIG_IDF_TARGET_ESP32C3
+#include <esp_pm.h>
+#define POWER_USE_PM 1
+#else
+#define POWER_USE_PM 0
+#endif
+#include "log_events.h"
 
 // === WebSocket & HTTP Server ===
 WebSocketsServer webSocket(81);
 AsyncWebServer server(80);
 DNSServer dns;
 
+// === Scheduler ===
+CoopScheduler scheduler;
+const uint8_t PRIO_SAFETY = 4;  // 緊急停止收尾
+const uint8_t PRIO_CONTROL = 3; // 馬達控制
+const uint8_t PRIO_NETWORK = 2;
+const uint8_t PRIO_BACKGROUND = 1;
+const uint32_t ESTOP_PERIOD_US = 1000;
+const uint32_t WS_PERIOD_US = 1000;
+int estopTaskId = -1;
+int speedTaskId = -1;
+int wsTaskId = -1;
+
+// === Tunable Parameters ===
+// 存在 NVS，可從 WebSocket {"params": {...}} 或 POST /params 現場調整，不用重新 OTA。
+// 控制迴圈一律用 params.get(P_xxx) 讀；衍生設定（PWM 頻率、速度前饋）由 applyParamChanges() 重新套用。
+// 只放真的有在用的參數：ramp 相關的值只在沒排程的 handleMotorRamping() 裡，仍是常數。
+enum ParamId : uint8_t {
+  P_MAX_DUTY,
+  P_COMMAND_TIMEOUT,
+  P_PWM_FREQ,
+  PARAM_COUNT
+};
+
+const ParamDef PARAM_DEFS[PARAM_COUNT] = {
+  { "max_duty",     1,    255,   200 },   // 最大 PWM（PWM_RES 8-bit）
+  { "cmd_timeout",  50,   5000,  300 },   // 多久沒收到新指令就停止（ms），見 Command Watchdog
+  { "pwm_freq",     1000, 40000, 20000 }, // 20 kHz (不可聽範圍)
+};
+
+ParamRegistry params(PARAM_DEFS, PARAM_COUNT);
+
 // === Motor A (Forward/Backward) ===
 const int motorA_pwm_fwd = 6;
 const int motorA_pwm_rev = 5;
@@ -22,20 +72,21 @@ const int motorB_pwm_right = 21;
 
 // === Motor Standby Pin ===
 const int motor_stby = 7; // Set HIGH to enable motors
+EmergencyStop emergencyStop; // 緊急停止期間不可開 STBY，見 Emergency Stop 區塊
 
 // LEDC channels
 const int CH_A_FWD = 0;
 const int CH_A_REV = 1;
 const int CH_B_LEFT = 2;
 const int CH_B_RIGHT = 3;
-const int PWM_FREQ = 20000; // 20 kHz (不可聽範圍)
 const int PWM_RES = 8; // 8-bit -> duty 0-255
 
 void setupPWM() {
-  ledcSetup(CH_A_FWD, PWM_FREQ, PWM_RES);
-  ledcSetup(CH_A_REV, PWM_FREQ, PWM_RES);
-  ledcSetup(CH_B_LEFT, PWM_FREQ, PWM_RES);
-  ledcSetup(CH_B_RIGHT, PWM_FREQ, PWM_RES);
+  uint32_t freq = params.get(P_PWM_FREQ);
+  ledcSetup(CH_A_FWD, freq, PWM_RES);
+  ledcSetup(CH_A_REV, freq, PWM_RES);
+  ledcSetup(CH_B_LEFT, freq, PWM_RES);
+  ledcSetup(CH_B_RIGHT, freq, PWM_RES);
 
   ledcAttachPin(motorA_pwm_fwd, CH_A_FWD);
   ledcAttachPin(motorA_pwm_rev, CH_A_REV);
@@ -91,6 +142,12 @@ const char index_html[] PROGMEM = R"rawliteral(
   <div id="motorStatus" style="margin-top:10px;font-size:1.1em;color:#0f0;">
     Motor A: 0 | Motor B: 0
   </div>
+  <button onclick="emergencyStop()" style="padding:15px 40px;margin:10px;font-size:1.2em;background:#ff0000;color:white;border:none;border-radius:8px;">E-STOP</button>
+  <div style="text-align:center;">
+    <button onclick="sendCmd('A')" style="padding:10px;margin:5px;background:#00bfff;color:white;border:none;border-radius:8px;">AUTO</button>
+    <button onclick="sendCmd('M')" style="padding:10px;margin:5px;background:#00bfff;color:white;border:none;border-radius:8px;">MANUAL</button>
+    <button onclick="sendCmd('R')" style="padding:10px;margin:5px;background:#ff8c00;color:white;border:none;border-radius:8px;">REC</button>
+  </div>
 
   <div style="text-align:center;margin-top:10px;display:none;">
     <button onclick="sendCmdName('forward')" style="padding:15px;margin:5px;background:#00bfff;color:white;border:none;border-radius:8px;">Forward</button>
@@ -124,12 +181,26 @@ const char index_html[] PROGMEM = R"rawliteral(
       }
     };
 
+    // 緊急停止：保留的二進位 opcode，firmware 不經過 JSON 解析直接處理
+    function emergencyStop() {
+      held = null;
+      if (ws.readyState === WebSocket.OPEN) {
+        ws.send(new Uint8Array([0xE5]));
+      }
+    }
+
     function sendCmd(cmd) {
       if (ws.readyState === WebSocket.OPEN) {
         ws.send(cmd);
       }
     }
 
+    // 行進中每 100 ms 重送目前的值，firmware 超過 cmd_timeout 沒收到指令會停車
+    let held = null;
+    setInterval(() => {
+      if (held) sendCmd(JSON.stringify(held));
+    }, 100);
+
     // 按鍵控制（用 name）
     function sendCmdName(name) {
       let steer = 0, throttle = 0;
@@ -140,6 +211,7 @@ const char index_html[] PROGMEM = R"rawliteral(
         case 'right': steer = 255; break;
         case 'stop': steer = 0; throttle = 0; break;
       }
+      held = (steer || throttle) ? { steer, throttle } : null;
       sendCmd(JSON.stringify({ steer, throttle, name }));
     }
 
@@ -174,6 +246,7 @@ const char index_html[] PROGMEM = R"rawliteral(
           steer = (Math.abs(steer) < deadzone * 255) ? 0 : steer;
           throttle = (Math.abs(throttle) < deadzone * 255) ? 0 : throttle;
 
+          held = (steer || throttle) ? { steer, throttle } : null;
           ws.send(JSON.stringify({ steer, throttle }));
         }
         lastSend = now;
@@ -181,6 +254,7 @@ const char index_html[] PROGMEM = R"rawliteral(
     });
 
     joystick.on('end', () => {
+      held = null;
       sendCmd(JSON.stringify({ steer: 0, throttle: 0 }));
     });
 
@@ -201,11 +275,10 @@ const char index_html[] PROGMEM = R"rawliteral(
 )rawliteral";
 
 // === Motor Control Functions ===
-// ---- 參數（可調） ----
-const int MAX_DUTY = 200;           // 最大 PWM（你目前用 200）
+// ---- 參數（可調）：max_duty / cmd_timeout 見 Tunable Parameters ----
 const unsigned long RAMP_INTERVAL_MS = 30; // ramp 更新間隔
-//const int RAMP_STEP = 6;            // 每次 ramp 增量（越小越溫和）
-const int RAMP_STEP = MAX_DUTY / 34; // roughly 6 if MAX_DUTY=200
+const int RAMP_STEP_DIV = 34;              // 每次 ramp 增量 = max_duty / 34（200 時約 6）
+const unsigned long STBY_IDLE_TIMEOUT_MS = 1500; // 停止後多久關 STBY
 
 // ---- 狀態變數 ----
 volatile int targetA = 0;  // 目標速度 -MAX..MAX (Motor A: 前後)
@@ -215,12 +288,10 @@ int currentB = 0;
 
 unsigned long lastRampMillis = 0;
 unsigned long lastActivityMillis = 0;
-const unsigned long STBY_IDLE_TIMEOUT_MS = 1500; // 停止後多久關 STBY
 unsigned long lastCommandTime = 0;
-const unsigned long COMMAND_TIMEOUT = 300; // 單位 ms, 0.3 秒沒收到新指令就停止
 
 void sendMotorStatus() {
-  StaticJsonDocument<64> status;
+  JsonDocument status;
   status["motorA"] = currentA;
   status["motorB"] = currentB;
   char buffer[64];
@@ -230,12 +301,14 @@ void sendMotorStatus() {
 
 // ---- 控制馬達啟用狀態 ----
 void motorEnable(bool enable) {
+  if (enable && !emergencyStop.allowsEnable()) return; // 緊急停止收尾前 / 鎖定中不開 STBY
   digitalWrite(motor_stby, enable ? HIGH : LOW);
 }
 
 // ---- 直接輸出到 PWM（保留你的 ledcWrite channel） ----
 void applyMotorA(int speed) {
-  speed = constrain(speed, -MAX_DUTY, MAX_DUTY);
+  int maxDuty = params.get(P_MAX_DUTY);
+  speed = constrain(speed, -maxDuty, maxDuty);
   if (speed > 0) {
     ledcWrite(CH_A_FWD, speed);
     ledcWrite(CH_A_REV, 0);
@@ -249,7 +322,8 @@ void applyMotorA(int speed) {
 }
 
 void applyMotorB(int speed) {
-  speed = constrain(speed, -MAX_DUTY, MAX_DUTY);
+  int maxDuty = params.get(P_MAX_DUTY);
+  speed = constrain(speed, -maxDuty, maxDuty);
   if (speed > 0) {
     ledcWrite(CH_B_RIGHT, speed);
     ledcWrite(CH_B_LEFT, 0);
@@ -262,15 +336,92 @@ void applyMotorB(int speed) {
   }
 }
 
+// ---- 閉迴路速度控制（Motor A） ----
+// ESP32-C3 沒有 PCNT，WheelEncoder 會改用 GPIO 中斷計數
+const int encoderA_pin = 3;
+const int encoderB_pin = 4;
+// 沒裝編碼器時改成 false，回到直接輸出 duty；忘了改也不會失控：
+// 有目標卻一直沒有計數時 SpeedLoop 判定編碼器失效，自動退回開迴路（/metrics speed.encoder_fault）
+const bool SPEED_CLOSED_LOOP = true;
+const int32_t MAX_SPEED_CPS = 3000;    // 指令 max_duty 對應的輪速（counts/s）
+const uint32_t SPEED_LOOP_HZ = 100;
+
+// Q8；前饋隨 max_duty 改變（和 native 測試用同一組預設增益）
+PidGains speedGains() {
+  return SpeedLoop::defaultGains(params.get(P_MAX_DUTY), MAX_SPEED_CPS);
+}
+
+WheelEncoder encoderA(encoderA_pin, encoderB_pin);
+SpeedLoop speedLoop;
+volatile int32_t speedSetpointCps = 0;
+int speedCommand = 0;   // 最近的 Motor A 指令 duty，編碼器失效時直接輸出
+int speedDuty = 0;
+uint32_t lastSpeedUs = 0;
+
+void setupSpeedControl() {
+  encoderA.begin();
+  speedLoop.setGains(speedGains());
+  speedLoop.setOutputLimit(params.get(P_MAX_DUTY));
+  lastSpeedUs = micros();
+}
+
+bool speedClosedLoop() {
+  return SPEED_CLOSED_LOOP && !speedLoop.encoderFault();
+}
+
+// Motor A 輸出：閉迴路時只設定輪速目標，duty 由 speedTask 計算
+void driveMotorA(int command) {
+  int maxDuty = params.get(P_MAX_DUTY);
+  command = constrain(command, -maxDuty, maxDuty);
+  speedCommand = command;
+  if (!speedClosedLoop()) {
+    applyMotorA(command);
+    return;
+  }
+  speedSetpointCps = (int32_t)command * MAX_SPEED_CPS / maxDuty;
+  if (command == 0) {
+    // 目標為 0 時直接放掉（與原本開迴路停車行為相同），不主動煞車
+    speedLoop.reset();
+    speedDuty = 0;
+    applyMotorA(0);
+  }
+}
+
+extern CommandPath commandPath;  // Command Handling
+
+// 固定頻率：量測輪速並更新 PID
+void speedTask(void *) {
+  uint32_t now = micros();
+  uint32_t elapsed = now - lastSpeedUs;
+  lastSpeedUs = now;
+  speedLoop.measure(encoderA.readDelta(), elapsed);
+
+  if (!speedClosedLoop() || speedSetpointCps == 0) return;
+  speedDuty = speedLoop.update(speedSetpointCps);
+  if (speedLoop.encoderFault()) {
+    // 沒有回授：之後都走開迴路，這次直接輸出指令 duty
+    LOGE(EV_SPEED_ENCODER_FAULT, speedSetpointCps, speedDuty);
+    speedLoop.reset();
+    speedDuty = speedCommand;
+  }
+  applyMotorA(speedDuty);
+  commandPath.outputApplied(micros()); // 等待中的指令，Motor A 輸出現在才寫到 PWM
+}
+
 // ---- 設定目標（由外部呼叫，例如 WebSocket handler） ----
+// Motor A 的目標是速度指令（-max_duty..max_duty），閉迴路時換算成輪速目標
 void setTargetMotorA(int speed) {
-  targetA = constrain(speed, -MAX_DUTY, MAX_DUTY);
+  int maxDuty = params.get(P_MAX_DUTY);
+  targetA = constrain(speed, -maxDuty, maxDuty);
+  LOGD(EV_TARGET, targetA, targetB);
   lastActivityMillis = millis();
   if (targetA != 0) motorEnable(true);
 }
 
 void setTargetMotorB(int speed) {
-  targetB = constrain(speed, -MAX_DUTY, MAX_DUTY);
+  int maxDuty = params.get(P_MAX_DUTY);
+  targetB = constrain(speed, -maxDuty, maxDuty);
+  LOGD(EV_TARGET, targetA, targetB);
   lastActivityMillis = millis();
   if (targetB != 0) motorEnable(true);
 }
@@ -287,7 +438,7 @@ void stopAllMotors() {
 // ---- 非阻塞 ramp 處理，放在 loop() 中呼叫 ----
 void handleMotorRamping() {
   // 超時檢查
-  if (millis() - lastCommandTime > COMMAND_TIMEOUT) {
+  if (millis() - lastCommandTime > (unsigned long)params.get(P_COMMAND_TIMEOUT)) {
     stopAllMotors();
     return; // 不做後續平滑運算
   }
@@ -296,29 +447,31 @@ void handleMotorRamping() {
   unsigned long now = millis();
   if (now - lastRampMillis < RAMP_INTERVAL_MS) return;
   lastRampMillis = now;
+  int rampStep = params.get(P_MAX_DUTY) / RAMP_STEP_DIV;
 
   // Ramp A
   if (currentA < targetA) {
-    currentA += RAMP_STEP;
+    currentA += rampStep;
     if (currentA > targetA) currentA = targetA;
   } else if (currentA > targetA) {
-    currentA -= RAMP_STEP;
+    currentA -= rampStep;
     if (currentA < targetA) currentA = targetA;
   }
 
   // Ramp B
   if (currentB < targetB) {
-    currentB += RAMP_STEP;
+    currentB += rampStep;
     if (currentB > targetB) currentB = targetB;
   } else if (currentB > targetB) {
-    currentB -= RAMP_STEP;
+    currentB -= rampStep;
     if (currentB < targetB) currentB = targetB;
   }
 
   // Apply to PWM
-  applyMotorA(currentA);
+  driveMotorA(currentA);
   applyMotorB(currentB);
   sendMotorStatus(); // send live updates
+  LOGD(EV_RAMP, currentA, currentB);
 
   // STBY 管理：若長時間沒有活動且兩邊都為 0，關閉 STBY
   if (currentA == 0 && currentB == 0 && targetA == 0 && targetB == 0) {
@@ -328,61 +481,131 @@ void handleMotorRamping() {
   } else {
     motorEnable(true);
   }
-
-  // Send motor status + debug
-  StaticJsonDocument<128> status;
-  status["motorA"] = currentA;
-  status["motorB"] = currentB;
-  status["debug"] = String("Ramping: currentA=") + currentA +
-                    " currentB=" + currentB +
-                    " targetA=" + targetA +
-                    " targetB=" + targetB;
-  char buffer[128];
-  size_t len = serializeJson(status, buffer);
-  webSocket.broadcastTXT(buffer, len);
 }
 
 // ---- 立即緊急停（立刻切 PWM=0 並關 STBY） ----
 void emergencyStopNow() {
   targetA = targetB = 0;
   currentA = currentB = 0;
-  applyMotorA(0);
+  driveMotorA(0);
   applyMotorB(0);
   motorEnable(false);
-  Serial.println("EMERGENCY STOP");
+}
+
+// === Emergency Stop ===
+// 觸發來源與保證時間：
+// - 實體按鈕（GPIO 中斷）：ISR 內直接拉低 STBY，H-bridge 立即停止輸出（微秒級）
+// - WebSocket opcode 0xE5（二進位 frame）或文字 "!"：在收到的當下完成，不經 String / JSON
+// - 斷線：WiFi 斷線事件立即拉低 STBY；WebSocket heartbeat 連續兩次沒回 pong
+//   （最長約 ESTOP_PING_INTERVAL_MS + 2 * ESTOP_PONG_TIMEOUT_MS）時視同斷線
+// PWM 歸零與狀態清除由最高優先權的 estopTask 收尾（<= 1 ms 週期）。
+// 停止後鎖住，直到收到一個 steer=0 / throttle=0 的搖桿 frame 才解除。
+// 切 STBY 到收尾之間（pending）motorEnable(true) 與搖桿指令一律拒絕。
+const int ESTOP_PIN = 9;              // 開發板 BOOT 鍵，按下為 LOW
+const uint8_t ESTOP_OPCODE = 0xE5;
+const char ESTOP_CHAR = '!';
+const uint32_t ESTOP_PING_INTERVAL_MS = 250;
+const uint32_t ESTOP_PONG_TIMEOUT_MS = 250;
+
+enum EstopSource : uint8_t { ESTOP_WS = 1, ESTOP_BUTTON, ESTOP_LINK_LOST, ESTOP_WIFI_LOST };
+
+int driverClient = -1;                 // 最後送搖桿指令的 WebSocket client
+
+void IRAM_ATTR requestEmergencyStop(uint8_t source) {
+  digitalWrite(motor_stby, LOW);
+  emergencyStop.request(source, micros());
+}
+
+void IRAM_ATTR onEstopButton() {
+  requestEmergencyStop(ESTOP_BUTTON);
+}
+
+void completeEmergencyStop() {
+  if (!emergencyStop.pending()) return;
+  emergencyStopNow();
+  emergencyStop.complete(micros());
+  LOGW(EV_EMERGENCY_STOP, emergencyStop.source(), emergencyStop.lastUs());
+}
+
+void estopTask(void *) {
+  completeEmergencyStop();
+}
+
+// 收尾前一律拒絕；鎖定時搖桿回中才解除，按鈕還按著時不解除
+bool estopReleased() {
+  return digitalRead(ESTOP_PIN) == HIGH;
+}
+
+// 由 wifiLink 在 WiFi 事件 task 呼叫；重連時自己下的 disconnect 不會進來
+void onWiFiLinkLost() {
+  requestEmergencyStop(ESTOP_WIFI_LOST);
+}
+
+void setupEmergencyStop() {
+  pinMode(ESTOP_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(ESTOP_PIN), onEstopButton, FALLING);
 }
 
 // === Command Handling ===
+// 前置宣告（AUTO 模式在 controlByJoystick 之後）
+enum AutoStopReason : uint8_t { AUTO_DONE = 0, AUTO_OVERRIDE, AUTO_ESTOP, AUTO_CMD };
+void startAutoMode();
+void stopAutoMode(uint8_t reason);
+void toggleRecording();
+
 void handleCarCommand(char cmd) {
   switch (cmd) {
-    case 'A': currentMode = AUTO; Serial.println("Mode: AUTO"); break;
-    case 'M': currentMode = MANUAL; Serial.println("Mode: MANUAL"); break;
+    case 'A': startAutoMode(); break;
+    case 'M': stopAutoMode(AUTO_CMD); break;
+    case 'R': toggleRecording(); break;
   }
 }
 
-void controlByJoystick(int steer, int throttle) {
-  // Save targets (for debug / status)
-  targetA = throttle;
-  targetB = steer;
+// 搖桿 frame 可帶 "seq"；指令的輸出真的寫到 PWM 後，狀態廣播才把它原樣帶回，
+// 給 tools/ws_loadgen.py 量指令 -> 輸出延遲。緊急停止檢查、寫輸出、延到 speedTask 之後
+// 才廣播都在 CommandPath（native 測試跑同一份），這裡只接硬體與 WebSocket。
+void commandDriveA(int throttle) {
+  targetA = throttle;  // Save targets (for debug / status)
+  driveMotorA(throttle);
+}
 
-  if (steer == 0 && throttle == 0) {
-    applyMotorA(0);
-    applyMotorB(0);
-    motorEnable(false);
-  } else {
-    motorEnable(true);
-    applyMotorA(throttle);
-    applyMotorB(steer);
-  }
+void commandDriveB(int steer) {
+  targetB = steer;
+  applyMotorB(steer);
+}
 
-  // Send motor status immediately
-  StaticJsonDocument<64> status;
-  status["motorA"] = throttle;
-  status["motorB"] = steer;
-  char buffer[64];
+void sendCommandStatus(int motorA, int motorB, uint32_t seq) {
+  JsonDocument status;
+  status["motorA"] = motorA;
+  status["motorB"] = motorB;
+  if (seq) status["seq"] = seq;
+  char buffer[96];
   size_t len = serializeJson(status, buffer);
   webSocket.broadcastTXT(buffer, len);
 }
+
+const CommandOutputs COMMAND_OUTPUTS = { commandDriveA, commandDriveB, motorEnable, speedClosedLoop, sendCommandStatus };
+CommandPath commandPath(emergencyStop, COMMAND_OUTPUTS);
+
+void controlByJoystick(int steer, int throttle) {
+  commandPath.control(steer, throttle, micros());
+}
+
+// ---- 指令 watchdog ----
+// 行進中超過 cmd_timeout 沒收到新指令（斷線、瀏覽器被切到背景）就停車。
+// 網頁在搖桿 / 方向鍵維持不動時每 100 ms 重送一次目前的值，所以握住不動不會被停。
+// AUTO 播放由 autoTask 自己更新 lastCommandTime。
+const uint32_t CMD_WATCHDOG_PERIOD_US = 50000;
+uint32_t commandTimeouts = 0;
+
+void commandWatchdogTask(void *) {
+  if (currentMode == AUTO || (targetA == 0 && targetB == 0)) return;
+  unsigned long idle = millis() - lastCommandTime;
+  if (idle <= (unsigned long)params.get(P_COMMAND_TIMEOUT)) return;
+  commandTimeouts++;
+  LOGW(EV_CMD_TIMEOUT, idle);
+  controlByJoystick(0, 0);
+}
 /*
 void controlByJoystick(int steer, int throttle) {
   if (steer == 0 && throttle == 0) {
@@ -394,50 +617,729 @@ void controlByJoystick(int steer, int throttle) {
   }
 }
 */
+
+// === AUTO Mode（軌跡播放） ===
+// 'A' 播放存在 NVS 的軌跡：autoTask 每 AUTO_PERIOD_MS 取樣一次並內插，
+// 取樣時間用 millis() - autoStartMs，task 被延遲或跳過週期時播放也不會變慢。
+// 任何搖桿 frame 立即切回 MANUAL；緊急停止也會中止播放。
+// 'R' 開始 / 停止錄製手動駕駛，停止後由 trajTask 存入 NVS（不在 WebSocket 路徑上寫 flash）；
+// 也可用 POST /trajectory 上傳。
+// NVS 直接寫 trajectory 的記憶體內容，不另外留緩衝；上傳用的緩衝只在上傳期間從 heap 配置。
+// nvs 分割區和 Wi-Fi / 參數共用，寫入可能因空間不足失敗：錄製的軌跡會保留 pending 定期重試，
+// 上傳則在寫入成功後才回應成功。
+const uint32_t AUTO_PERIOD_MS = 20;
+const uint32_t TRAJ_SAVE_RETRY_MS = 5000;
+
+Preferences prefs;
+Trajectory trajectory;
+int autoTaskId = -1;
+uint32_t autoStartMs = 0;
+bool recording = false;
+uint32_t recordStartMs = 0;
+std::atomic<bool> trajSavePending(false);      // 錄製結束，等 trajTask 寫入 NVS（失敗時保留）
+uint32_t trajSaveRetryMs = 0;
+
+uint8_t *trajUploadBuf = nullptr;              // HTTP 上傳（async_tcp task 配置與寫入）
+size_t trajUploadLen = 0;
+std::atomic<bool> trajUploadReady(false);      // 已驗證並存入 NVS，緩衝交給 trajTask 載入後釋放
+volatile int trajUploadResult = 0;             // 1 ok, -1 格式錯誤, -2 忙碌或太大, -3 NVS 寫入失敗
+
+int16_t trajMaxValue() {
+  return (int16_t)params.get(P_MAX_DUTY);
+}
+
+// 開機時讀一次，暫存緩衝用完就釋放
+void loadTrajectory() {
+  size_t len = prefs.getBytesLength("traj");
+  if (len == 0 || len > Trajectory::MAX_BYTES) return;
+  uint8_t *buf = (uint8_t *)malloc(len);
+  if (!buf) return;
+  if (prefs.getBytes("traj", buf, len) != len || !trajectory.load(buf, len, trajMaxValue())) {
+    LOGW(EV_TRAJ_REJECTED, len);
+  }
+  free(buf);
+}
+
+bool writeTrajectory(const uint8_t *data, size_t len, uint16_t count) {
+  size_t written = prefs.putBytes("traj", data, len);
+  if (written != len) {
+    LOGE(EV_TRAJ_SAVE_FAILED, written, len);
+    return false;
+  }
+  LOGI(EV_TRAJ_SAVED, count, len);
+  return true;
+}
+
+void saveTrajectory() {
+  if (writeTrajectory(trajectory.data(), trajectory.serializedSize(), trajectory.count())) {
+    trajSavePending = false;
+  } else {
+    trajSaveRetryMs = millis() + TRAJ_SAVE_RETRY_MS;
+  }
+}
+
+// trajTask 載入後、或開始錄製時（錄製的會蓋過上傳的）釋放上傳緩衝
+void releaseTrajectoryUpload() {
+  free(trajUploadBuf);
+  trajUploadBuf = nullptr;
+  trajUploadReady.store(false, std::memory_order_release);
+}
+
+void startAutoMode() {
+  if (currentMode == AUTO || !emergencyStop.allowsEnable()) return;
+  if (recording) toggleRecording();
+  if (trajectory.empty()) {
+    LOGW(EV_AUTO_EMPTY);
+    return;
+  }
+  currentMode = AUTO;
+  autoStartMs = millis();
+  scheduler.setEnabled(autoTaskId, true);
+  scheduler.trigger(autoTaskId);
+  LOGI(EV_MODE, AUTO);
+  LOGI(EV_AUTO_START, trajectory.count(), trajectory.durationMs());
+}
+
+void stopAutoMode(uint8_t reason) {
+  if (currentMode != AUTO) return;
+  currentMode = MANUAL;
+  scheduler.setEnabled(autoTaskId, false);
+  // 手動接管時由接下來的搖桿指令決定輸出，其他情況停車
+  if (reason != AUTO_OVERRIDE) controlByJoystick(0, 0);
+  LOGI(EV_MODE, MANUAL);
+  LOGI(EV_AUTO_STOP, reason);
+}
+
+void autoTask(void *) {
+  if (currentMode != AUTO) return;
+  if (!emergencyStop.allowsEnable()) {
+    stopAutoMode(AUTO_ESTOP);
+    return;
+  }
+
+  int16_t steer, throttle;
+  if (!trajectory.sample(millis() - autoStartMs, steer, throttle)) {
+    stopAutoMode(AUTO_DONE);
+    return;
+  }
+  controlByJoystick(steer, throttle);
+  lastCommandTime = millis();
+}
+
+void toggleRecording() {
+  if (!recording) {
+    if (currentMode == AUTO) return;
+    if (trajUploadReady.load(std::memory_order_acquire)) releaseTrajectoryUpload();
+    trajectory.clear();
+    trajectory.append(0, 0, 0);
+    recordStartMs = millis();
+    trajSavePending = false;
+    recording = true;
+    LOGI(EV_REC_START);
+    return;
+  }
+  // 結尾補停車 keyframe（含前一個值的 hold），播放完一定是停的；
+  // 原本就停著時 record() 不會加，由 append() 補上結尾時間
+  uint32_t t = millis() - recordStartMs;
+  trajectory.record(t, 0, 0);
+  trajectory.append(t, 0, 0);
+  recording = false;
+  trajSavePending = true;
+  trajSaveRetryMs = millis();
+  LOGI(EV_REC_STOP, trajectory.count());
+}
+
+void recordFrame(int steer, int throttle) {
+  // 這一筆和結尾的停車各最多佔 2 格（含 hold keyframe）
+  if (trajectory.count() + 4 > Trajectory::MAX_KEYFRAMES) {
+    toggleRecording();
+    return;
+  }
+  trajectory.record(millis() - recordStartMs, steer, throttle);
+}
+
+// NVS 寫入與上傳的軌跡都在 loop 這邊的低優先權 task 處理，
+// 不佔 WebSocket 路徑，也避免和 autoTask 同時存取
+void trajTask(void *) {
+  if (currentMode == AUTO || recording) return;
+  if (trajSavePending) {
+    if ((int32_t)(millis() - trajSaveRetryMs) >= 0) saveTrajectory();
+    return;
+  }
+  if (!trajUploadReady.load(std::memory_order_acquire)) return;
+  // NVS 已經在上傳時寫好，這裡只換掉記憶體中的軌跡
+  trajectory.load(trajUploadBuf, trajUploadLen, trajMaxValue());
+  releaseTrajectoryUpload();
+}
+
+// 上傳直接收進一塊剛好大小的 heap 緩衝；驗證後在這裡（async_tcp task）寫 NVS，
+// 寫入成功才回應成功，緩衝再交給 trajTask
+void handleTrajectoryBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (index == 0) {
+    trajUploadResult = -2;
+    // 錄製中或錄製的還沒存好時不收，免得 NVS 和記憶體中的軌跡不一致
+    if (trajUploadReady.load(std::memory_order_acquire) || recording || trajSavePending) return;
+    if (total > Trajectory::MAX_BYTES) return;
+    free(trajUploadBuf);  // 上一次上傳中途斷線留下的
+    trajUploadBuf = (uint8_t *)malloc(total);
+    if (!trajUploadBuf) return;
+    trajUploadResult = 0;
+  }
+  if (trajUploadResult != 0 || !trajUploadBuf) return;
+  memcpy(trajUploadBuf + index, data, len);
+  if (index + len < total) return;
+
+  if (!Trajectory::validate(trajUploadBuf, total, trajMaxValue())) {
+    trajUploadResult = -1;
+    LOGW(EV_TRAJ_REJECTED, total);
+  } else if (!writeTrajectory(trajUploadBuf, total, (total - sizeof(TrajectoryHeader)) / sizeof(Keyframe))) {
+    trajUploadResult = -3;
+  } else {
+    trajUploadLen = total;
+    trajUploadResult = 1;
+    trajUploadReady.store(true, std::memory_order_release);
+    return;
+  }
+  free(trajUploadBuf);
+  trajUploadBuf = nullptr;
+}
+
+void handleTrajectoryPost(AsyncWebServerRequest *request) {
+  // 沒有 body 時 handleTrajectoryBody 不會被呼叫，結果必須每次用完就清掉
+  int result = trajUploadResult;
+  trajUploadResult = 0;
+  if (result == 1) {
+    request->send(200, "text/plain", "saved");
+  } else if (result == -2) {
+    request->send(503, "text/plain", "busy or too large");
+  } else if (result == -3) {
+    request->send(507, "text/plain", "storage full");
+  } else if (result == -1) {
+    request->send(400, "text/plain", "invalid trajectory");
+  } else {
+    request->send(400, "text/plain", "empty body");
+  }
+}
+
+// === Parameter Updates ===
+// WebSocket 的更新在 loop 裡直接套用；HTTP 在 async_tcp task，先驗證後排隊給 paramsTask。
+// NVS 寫入也交給 paramsTask，避免在控制路徑上等 flash。
+// paramsPendingReady 是交接旗標：HTTP 填好整批後 release 設 true，paramsTask acquire 讀到 true
+// 才讀 paramsPending，用完再 release 清掉，HTTP 端 acquire 讀到 false 才能再寫
+ParamUpdate paramsPending[ParamRegistry::MAX_PARAMS];
+uint8_t paramsPendingCount = 0;
+std::atomic<bool> paramsPendingReady(false);
+
+// 依最近一次變更重新套用衍生設定
+void applyParamChanges() {
+  uint32_t changed = params.changedMask();
+  if (changed & (1UL << P_PWM_FREQ)) {
+    uint32_t freq = params.get(P_PWM_FREQ);
+    ledcChangeFrequency(CH_A_FWD, freq, PWM_RES);
+    ledcChangeFrequency(CH_A_REV, freq, PWM_RES);
+    ledcChangeFrequency(CH_B_LEFT, freq, PWM_RES);
+    ledcChangeFrequency(CH_B_RIGHT, freq, PWM_RES);
+  }
+  if (changed & (1UL << P_MAX_DUTY)) {
+    speedLoop.setGains(speedGains());
+    speedLoop.setOutputLimit(params.get(P_MAX_DUTY));
+  }
+}
+
+bool applyParams(const ParamUpdate *updates, uint8_t n) {
+  uint32_t generation = params.generation();
+  int bad = params.apply(updates, n);
+  if (bad >= 0) {
+    LOGW(EV_PARAMS_REJECTED, n, bad);
+    return false;
+  }
+  if (params.generation() != generation) {
+    applyParamChanges();
+    LOGI(EV_PARAMS_UPDATED, params.changedMask(), params.generation());
+  }
+  return true;
+}
+
+// {"max_duty": 180, ...} -> updates；有不認得的名稱、不是整數的值或太多項就整批不收
+int parseParams(JsonObject obj, ParamUpdate *updates) {
+  uint8_t n = 0;
+  for (JsonPair kv : obj) {
+    int id = params.find(kv.key().c_str());
+    if (id < 0 || n >= ParamRegistry::MAX_PARAMS || !kv.value().is<int32_t>()) return -1;
+    updates[n++] = { (uint8_t)id, kv.value().as<int32_t>() };
+  }
+  return n;
+}
+
+// form 值必須整個是十進位整數；toInt() 對 "abc" 會回傳 0，不能拿來判斷
+bool parseParamValue(const String &text, int32_t &value) {
+  const char *s = text.c_str();
+  char *end = nullptr;
+  long long v = strtoll(s, &end, 10); // 溢位時會飽和，一樣超出 int32 範圍
+  if (end == s || *end != '\0' || v < INT32_MIN || v > INT32_MAX) return false;
+  value = (int32_t)v;
+  return true;
+}
+
+void paramsToJson(JsonObject obj) {
+  for (uint8_t i = 0; i < params.count(); i++) {
+    obj[params.def(i).key] = params.get(i);
+  }
+}
+
+void sendParams(uint8_t num, bool ok) {
+  JsonDocument reply;
+  reply["params_ok"] = ok;
+  paramsToJson(reply["params"].to<JsonObject>());
+  char buffer[384];
+  size_t len = serializeJson(reply, buffer);
+  webSocket.sendTXT(num, buffer, len);
+}
+
+void paramsTask(void *) {
+  if (paramsPendingReady.load(std::memory_order_acquire)) {
+    applyParams(paramsPending, paramsPendingCount);
+    paramsPendingReady.store(false, std::memory_order_release);
+  }
+  params.save(prefs);
+}
+
+// GET /params：目前值與範圍（async_tcp task，用 snapshot 讀同一批值）
+void handleParamsGet(AsyncWebServerRequest *request) {
+  int32_t values[ParamRegistry::MAX_PARAMS];
+  params.snapshot(values);
+  JsonDocument doc;
+  for (uint8_t i = 0; i < params.count(); i++) {
+    const ParamDef &d = params.def(i);
+    JsonObject p = doc[d.key].to<JsonObject>();
+    p["value"] = values[i];
+    p["min"] = d.min;
+    p["max"] = d.max;
+    p["default"] = d.def;
+  }
+  String body;
+  serializeJson(doc, body);
+  request->send(200, "application/json", body);
+}
+
+// POST /params（form 參數，例如 max_duty=180&cmd_timeout=500）
+void handleParamsPost(AsyncWebServerRequest *request) {
+  if (paramsPendingReady.load(std::memory_order_acquire)) {
+    request->send(503, "text/plain", "busy");
+    return;
+  }
+  if (request->params() > ParamRegistry::MAX_PARAMS) {
+    request->send(400, "text/plain", "too many parameters");
+    return;
+  }
+  uint8_t n = 0;
+  for (size_t i = 0; i < request->params(); i++) {
+    AsyncWebParameter *p = request->getParam(i);
+    int id = params.find(p->name().c_str());
+    if (id < 0) {
+      request->send(400, "text/plain", "unknown parameter: " + p->name());
+      return;
+    }
+    int32_t value = 0;
+    if (!parseParamValue(p->value(), value)) {
+      request->send(400, "text/plain", "not an integer: " + p->name());
+      return;
+    }
+    if (!params.valid(id, value)) {
+      request->send(400, "text/plain", "out of range: " + p->name());
+      return;
+    }
+    paramsPending[n++] = { (uint8_t)id, value };
+  }
+  paramsPendingCount = n;
+  paramsPendingReady.store(true, std::memory_order_release);
+  request->send(202, "text/plain", "accepted");
+}
+
+// === Power Management ===
+// 停著沒人操作時降頻，再久一點且沒有 WebSocket client 就進 light sleep；
+// 連線或收到指令立刻回全速（wake_us 為切回全速花的時間）；heartbeat 的 ping/pong 不算。
+// 先用 esp_pm_configure（DFS + 自動 light sleep）；light sleep 設定失敗（沒開 tickless idle）
+// 就只用 DFS，esp_pm 完全不能用（沒開 CONFIG_PM_ENABLE）就退回 setCpuFrequencyMhz
+// 降頻（WiFi 需要至少 80 MHz）。/metrics 的 power 區塊回報實際套用的結果，電流估計也跟著調整。
+// PARKED 時 estop / speed / ws task 放慢到 POWER_PARKED_PERIOD_US，loop 才睡得下去；
+// 實體緊急停止仍由 ISR 直接切 STBY，不受影響。
+// 喚醒上限 ≈ PARKED 的 ws 輪詢週期 + WiFi modem sleep 的 DTIM 間隔 + wake_us。
+const uint32_t POWER_PARKED_PERIOD_US = 20000;
+const PowerProfile POWER_PROFILE = {
+  5000,   // 5 s 沒指令 -> IDLE
+  60000,  // 1 分鐘且沒有 client -> PARKED
+  // 估計電流（mA，不含馬達）：160 MHz + WiFi 全開 / 80 MHz + modem sleep / PARKED（light sleep）
+  { 80, 30, 5 },
+};
+const uint16_t POWER_PARKED_AWAKE_MA = 20; // PARKED 但 light sleep 沒開起來
+
+IdlePower idlePower(POWER_PROFILE);
+bool powerPmActive = false;      // esp_pm 可用（否則用 setCpuFrequencyMhz）
+bool powerLightSleep = false;    // 目前真的開著自動 light sleep
+int32_t powerPmError = 0;        // 最近一次 esp_pm_configure 的錯誤碼
+uint32_t powerWakes = 0;
+uint32_t powerLastWakeUs = 0;
+uint32_t powerMaxWakeUs = 0;
+
+#if POWER_USE_PM
+// 回傳 false 時 esp_pm 不能用，呼叫端改用 setCpuFrequencyMhz
+bool configurePm(PowerState state) {
+  esp_pm_config_esp32c3_t cfg;
+  cfg.max_freq_mhz = 160;
+  cfg.min_freq_mhz = state == POWER_ACTIVE ? 160 : (state == POWER_IDLE ? 80 : 40);
+  cfg.light_sleep_enable = state == POWER_PARKED;
+  esp_err_t err = esp_pm_configure(&cfg);
+  if (err != ESP_OK && cfg.light_sleep_enable) {
+    LOGW(EV_POWER_PM_FAILED, err, 1, 0);
+    powerPmError = err;
+    cfg.light_sleep_enable = false; // 只降頻
+    err = esp_pm_configure(&cfg);
+  }
+  if (err != ESP_OK) {
+    LOGW(EV_POWER_PM_FAILED, err, cfg.light_sleep_enable, 1);
+    powerPmError = err;
+    return false;
+  }
+  powerLightSleep = cfg.light_sleep_enable;
+  return true;
+}
+#endif
+
+void applyPowerState(PowerState state) {
+  powerLightSleep = false;
+#if POWER_USE_PM
+  if (powerPmActive) powerPmActive = configurePm(state);
+#endif
+  if (!powerPmActive) setCpuFrequencyMhz(state == POWER_ACTIVE ? 160 : 80);
+  if (state == POWER_PARKED && !powerLightSleep) idlePower.setCurrentMa(POWER_PARKED_AWAKE_MA, millis());
+
+  bool parked = state == POWER_PARKED;
+  scheduler.setPeriod(estopTaskId, parked ? POWER_PARKED_PERIOD_US : ESTOP_PERIOD_US);
+  scheduler.setPeriod(speedTaskId, parked ? POWER_PARKED_PERIOD_US : 1000000 / SPEED_LOOP_HZ);
+  scheduler.setPeriod(wsTaskId, parked ? POWER_PARKED_PERIOD_US : WS_PERIOD_US);
+  LOGI(EV_POWER_STATE, state, getCpuFrequencyMhz());
+}
+
+// 收到指令 / 連線時呼叫；不在 ACTIVE 就立刻恢復全速
+void powerActivity() {
+  uint32_t start = micros();
+  if (!idlePower.activity(millis())) return;
+  applyPowerState(POWER_ACTIVE);
+  scheduler.trigger(estopTaskId);
+  scheduler.trigger(speedTaskId);
+  powerLastWakeUs = micros() - start;
+  if (powerLastWakeUs > powerMaxWakeUs) powerMaxWakeUs = powerLastWakeUs;
+  powerWakes++;
+}
+
+void powerTask(void *) {
+  // 車在動、AUTO 播放或錄製中都算活動
+  if (currentMode == AUTO || recording || targetA != 0 || targetB != 0) {
+    powerActivity();
+    return;
+  }
+  if (!idlePower.update(millis(), webSocket.connectedClients() == 0)) return;
+  if (idlePower.state() != POWER_ACTIVE) motorEnable(false); // 目標都是 0，STBY 可以關
+  applyPowerState(idlePower.state());
+}
+
+void setupPower() {
+#if POWER_USE_PM
+  // 沒開 CONFIG_PM_ENABLE 時回傳 ESP_ERR_NOT_SUPPORTED，之後都走 setCpuFrequencyMhz
+  powerPmActive = configurePm(POWER_ACTIVE);
+#endif
+  idlePower.begin(millis());
+}
+
 // === WebSocket Event ===
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
-  if (type == WStype_TEXT) {
+  // 緊急停止優先處理，不做任何複製或解析
+  if ((type == WStype_BIN && length >= 1 && payload[0] == ESTOP_OPCODE) ||
+      (type == WStype_TEXT && length == 1 && payload[0] == ESTOP_CHAR)) {
+    requestEmergencyStop(ESTOP_WS);
+    completeEmergencyStop();
+    return;
+  }
+  uint32_t rxUs = micros();
+  // 只有連線與真正的指令算活動；heartbeat 每 250 ms 的 ping/pong 不能讓車一直醒著
+  if (type == WStype_CONNECTED || type == WStype_TEXT || type == WStype_BIN) powerActivity();
+
+  if (type == WStype_CONNECTED) {
+    LOGI(EV_WS_CONNECT, num);
+  } else if (type == WStype_DISCONNECTED) {
+    LOGI(EV_WS_DISCONNECT, num);
+    if (num == driverClient) {
+      // 駕駛的連線斷了（含 heartbeat 逾時）
+      driverClient = -1;
+      requestEmergencyStop(ESTOP_LINK_LOST);
+      completeEmergencyStop();
+    }
+  } else if (type == WStype_TEXT) {
     String msg = String((char*)payload);
-    Serial.printf("[WS] Received: %s\n", msg.c_str());
+    LOGD(EV_WS_RECEIVED, num, length);
 
     if (msg.length() == 1) {
       handleCarCommand(msg.charAt(0));
       lastCommandTime = millis(); // update for single-character commands too
     } else {
-      StaticJsonDocument<256> doc;
+      JsonDocument doc;
       DeserializationError err = deserializeJson(doc, msg);
-      if (!err) {
+      if (!err && doc["params"].is<JsonObject>()) {
+        ParamUpdate updates[ParamRegistry::MAX_PARAMS];
+        int n = parseParams(doc["params"].as<JsonObject>(), updates);
+        sendParams(num, n >= 0 && applyParams(updates, n));
+      } else if (!err) {
         int steer = doc["steer"] | 0;
         int throttle = doc["throttle"] | 0;
-        controlByJoystick(steer, throttle);
+        driverClient = num;
+        if (currentMode == AUTO) stopAutoMode(AUTO_OVERRIDE); // 手動立即接管
+        bool wasLatched = emergencyStop.latched();
+        bool accepted = commandPath.joystick(steer, throttle, doc["seq"] | 0, rxUs, estopReleased(), micros());
+        if (wasLatched && !emergencyStop.latched()) LOGI(EV_ESTOP_CLEARED);
+        if (!accepted) return;
+        if (recording) recordFrame(steer, throttle);
         lastCommandTime = millis(); // update timestamp for joystick commands
-
-        // Send debug to browser
-        StaticJsonDocument<128> dbg;
-        dbg["debug"] = String("Joystick received:") +
-                       " throttle=" + throttle +
-                       " steer=" + steer +
-                       " targetA=" + targetA +
-                       " targetB=" + targetB;
-        char buffer[128];
-        size_t len = serializeJson(dbg, buffer);
-        webSocket.broadcastTXT(buffer, len);
+        LOGI(EV_JOYSTICK, throttle, steer); // debug 由 logDrainTask 送到瀏覽器
       } else {
-        Serial.print("JSON parse error: ");
-        Serial.println(err.c_str());
+        LOGW(EV_JSON_ERROR, err.code(), length);
       }
     }
   }
 }
 
+// === WiFi Connection ===
+// 開機先用 NVS 裡的 BSSID / channel 快速加入（IP 走 DHCP），失敗才開 WiFiManager 設定頁。
+// 之後斷線由 wifiTask 在背景重連；有駕駛連線時關掉 modem 省電。
+// 斷線當下的停車由 wifiLink 的 link-lost callback 觸發 Emergency Stop。
+WiFiLink wifiLink(prefs);
+
 void connectToWiFi() {
-  AsyncWiFiManager wm(&server, &dns);
-  wm.setDebugOutput(true);
-  wm.autoConnect("ESP32-Setup");
+  if (wifiLink.fastJoin()) {
+    LOGI(EV_WIFI_FAST_JOIN, wifiLink.stats().bootJoinMs, WiFi.channel());
+  } else {
+    AsyncWiFiManager wm(&server, &dns);
+    wm.setDebugOutput(true);
+    wm.autoConnect("ESP32-Setup");
+  }
+  wifiLink.onLinkLost(onWiFiLinkLost);
+  wifiLink.begin();
+}
+
+void wifiTask(void *) {
+  static uint32_t reportedReconnects = 0;
+  wifiLink.setPowerSave(driverClient < 0);
+  wifiLink.service();
+
+  const WiFiLinkStats &s = wifiLink.stats();
+  if (s.reconnects != reportedReconnects) {
+    reportedReconnects = s.reconnects;
+    LOGI(EV_WIFI_RECONNECTED, s.lastReconnectMs, WiFi.channel());
+  }
+}
+
+// === Memory ===
+// memTask 每秒取樣一次 heap，記錄最低剩餘與最小可配置區塊（碎片化的指標）。
+// 各 FreeRTOS task 的 stack 用 high-water mark 看：值為從未用到的最少 bytes。
+const uint32_t LOW_HEAP_WARN_BYTES = 24 * 1024;
+const char *const STACK_WATCH_TASKS[] = { "loopTask", "async_tcp", "arduino_events", "tiT" };
+
+uint32_t heapMinLargestBlock = UINT32_MAX;
+bool lowHeapWarned = false;
+
+void memTask(void *) {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largest = ESP.getMaxAllocHeap();
+  if (largest < heapMinLargestBlock) heapMinLargestBlock = largest;
+
+  if (freeHeap < LOW_HEAP_WARN_BYTES && !lowHeapWarned) {
+    LOGW(EV_LOW_HEAP, freeHeap, largest);
+    lowHeapWarned = true;
+  } else if (freeHeap >= LOW_HEAP_WARN_BYTES + 4096) {
+    lowHeapWarned = false; // 留一點遲滯，避免在門檻附近洗 log
+  }
+}
+
+void memoryToJson(JsonObject mem) {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largest = ESP.getMaxAllocHeap();
+  mem["heap_size"] = ESP.getHeapSize();
+  mem["heap_free"] = freeHeap;
+  mem["heap_min_free"] = ESP.getMinFreeHeap();
+  mem["heap_largest_block"] = largest;
+  mem["heap_min_largest_block"] = heapMinLargestBlock;
+  mem["fragmentation_pct"] = freeHeap ? 100 - largest * 100 / freeHeap : 0;
+  mem["sketch_size"] = ESP.getSketchSize();
+  mem["sketch_free"] = ESP.getFreeSketchSpace();
+
+  JsonObject stacks = mem["stack_free_min"].to<JsonObject>();
+  for (const char *name : STACK_WATCH_TASKS) {
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task) stacks[name] = uxTaskGetStackHighWaterMark(task);
+  }
+}
+
+// === Metrics ===
+void handleMetrics(AsyncWebServerRequest *request) {
+  JsonDocument doc;
+  doc["uptime_ms"] = millis();
+  doc["cpu_load_permille"] = scheduler.loadPermille();
+  doc["log_written"] = binlog.written();
+  doc["log_dropped"] = binlog.dropped();
+  memoryToJson(doc["memory"].to<JsonObject>());
+
+  uint32_t nowMs = millis();
+  JsonObject power = doc["power"].to<JsonObject>();
+  power["state"] = IdlePower::name(idlePower.state());
+  power["pm"] = powerPmActive;
+  power["light_sleep"] = powerLightSleep;
+  power["pm_error"] = powerPmError;
+  power["cpu_mhz"] = getCpuFrequencyMhz();
+  power["current_ma"] = idlePower.currentMa();
+  power["avg_current_ma"] = idlePower.averageCurrentMa(nowMs);
+  power["consumed_mah"] = idlePower.consumedMah(nowMs);
+  power["wakes"] = powerWakes;
+  power["last_wake_us"] = powerLastWakeUs;
+  power["max_wake_us"] = powerMaxWakeUs;
+  JsonObject timeMs = power["time_ms"].to<JsonObject>();
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    timeMs[IdlePower::name((PowerState)i)] = idlePower.timeInStateMs((PowerState)i, nowMs);
+  }
+
+  JsonObject wsStats = doc["ws"].to<JsonObject>();
+  wsStats["clients"] = webSocket.connectedClients();
+  wsStats["commands"] = commandPath.accepted();
+  wsStats["rejected"] = commandPath.rejected();
+  wsStats["superseded"] = commandPath.superseded();
+  wsStats["timeouts"] = commandTimeouts;
+  // 收到指令 -> 輸出寫到 PWM（只算帶 seq 的指令）
+  const LatencyStats &outputLatency = commandPath.latency();
+  JsonObject output = wsStats["output_us"].to<JsonObject>();
+  output["count"] = outputLatency.count();
+  output["p50"] = outputLatency.percentile(50);
+  output["p99"] = outputLatency.percentile(99);
+  output["max"] = outputLatency.maxUs();
+
+  JsonObject estop = doc["estop"].to<JsonObject>();
+  estop["count"] = emergencyStop.count();
+  estop["latched"] = emergencyStop.latched();
+  estop["last_us"] = emergencyStop.lastUs();
+  estop["max_us"] = emergencyStop.maxUs();
+
+  JsonObject speed = doc["speed"].to<JsonObject>();
+  speed["closed_loop"] = speedClosedLoop();
+  speed["encoder_fault"] = speedLoop.encoderFault();
+  speed["pcnt"] = encoderA.usingPcnt();
+  speed["setpoint_cps"] = speedSetpointCps;
+  speed["measured_cps"] = speedLoop.measuredCps();
+  speed["duty"] = speedDuty;
+  speed["integral"] = speedLoop.pid().integral();
+  speed["saturated"] = speedLoop.pid().saturated();
+  speed["encoder_total"] = encoderA.total();
+
+  JsonObject autoMode = doc["auto"].to<JsonObject>();
+  autoMode["active"] = currentMode == AUTO;
+  autoMode["recording"] = recording;
+  autoMode["keyframes"] = trajectory.count();
+  autoMode["duration_ms"] = trajectory.durationMs();
+  autoMode["position_ms"] = currentMode == AUTO ? millis() - autoStartMs : 0;
+
+  const WiFiLinkStats &ws = wifiLink.stats();
+  JsonObject wifi = doc["wifi"].to<JsonObject>();
+  wifi["connected"] = wifiLink.connected();
+  wifi["rssi"] = WiFi.RSSI();
+  wifi["channel"] = WiFi.channel();
+  wifi["power_save"] = wifiLink.powerSave();
+  wifi["boot_join_ms"] = ws.bootJoinMs;
+  wifi["reconnects"] = ws.reconnects;
+  wifi["fast_joins"] = ws.fastJoins;
+  wifi["last_reconnect_ms"] = ws.lastReconnectMs;
+  wifi["max_reconnect_ms"] = ws.maxReconnectMs;
+  wifi["total_outage_ms"] = ws.totalOutageMs;
+
+  JsonArray tasks = doc["tasks"].to<JsonArray>();
+  for (int i = 0; i < CoopScheduler::MAX_TASKS; i++) {
+    TaskInfo info;
+    if (!scheduler.taskInfo(i, info)) continue;
+    JsonObject t = tasks.add<JsonObject>();
+    t["name"] = info.name;
+    t["prio"] = info.priority;
+    t["period_us"] = info.periodUs;
+    t["runs"] = info.stats->runs;
+    t["avg_us"] = info.stats->avgUs();
+    t["max_us"] = info.stats->maxUs;
+    t["max_late_us"] = info.stats->maxLateUs;
+    t["overruns"] = info.stats->overruns;
+    t["missed"] = info.stats->missed;
+  }
+
+  String body;
+  serializeJson(doc, body);
+  request->send(200, "application/json", body);
+}
+
+// === Tasks ===
+void otaTask(void *) {
+  ArduinoOTA.handle();
+}
+
+void webSocketTask(void *) {
+  webSocket.loop();
+}
+
+void rampTask(void *) {
+  handleMotorRamping();
+}
+
+// 低優先權：把 binlog 的記錄格式化後送到 Serial 與瀏覽器（debug 欄位）
+const bool LOG_TO_WEBSOCKET = true;
+const int LOG_DRAIN_BATCH = 8; // 每次最多處理幾筆，避免佔住 loop
+
+void logDrainTask(void *) {
+  LogRecord rec;
+  for (int i = 0; i < LOG_DRAIN_BATCH && binlog.pop(rec); i++) {
+    char line[112];
+    size_t len = BinLog::format(rec, logFormats, LOG_EVENT_COUNT, line, sizeof(line));
+#ifdef BINLOG_SERIAL_BINARY
+    // 給 tools/binlog_decode.py 解碼
+    const uint8_t sync[2] = { BINLOG_SYNC0, BINLOG_SYNC1 };
+    Serial.write(sync, sizeof(sync));
+    Serial.write((const uint8_t *)&rec, sizeof(rec));
+#else
+    Serial.write((const uint8_t *)line, len);
+    Serial.write('\n');
+#endif
+
+    if (LOG_TO_WEBSOCKET) {
+      JsonDocument dbg;
+      dbg["debug"] = line;
+      char buffer[160];
+      size_t n = serializeJson(dbg, buffer);
+      webSocket.broadcastTXT(buffer, n);
+    }
+  }
+}
+
+void setupTasks() {
+  estopTaskId = scheduler.addPeriodic("estop", estopTask, ESTOP_PERIOD_US, PRIO_SAFETY);
+  speedTaskId = scheduler.addPeriodic("speed", speedTask, 1000000 / SPEED_LOOP_HZ, PRIO_CONTROL);
+  wsTaskId = scheduler.addPeriodic("ws", webSocketTask, WS_PERIOD_US, PRIO_NETWORK);
+  scheduler.addPeriodic("wifi", wifiTask, 50000, PRIO_NETWORK);
+  scheduler.addPeriodic("ota", otaTask, 20000, PRIO_BACKGROUND);
+  //scheduler.addPeriodic("ramp", rampTask, RAMP_INTERVAL_MS * 1000, PRIO_CONTROL); // 處理馬達漸進
+  scheduler.addPeriodic("cmdwd", commandWatchdogTask, CMD_WATCHDOG_PERIOD_US, PRIO_CONTROL);
+  scheduler.addPeriodic("log", logDrainTask, 20000, PRIO_BACKGROUND);
+  scheduler.addPeriodic("traj", trajTask, 100000, PRIO_BACKGROUND);
+  scheduler.addPeriodic("params", paramsTask, 100000, PRIO_BACKGROUND);
+  scheduler.addPeriodic("mem", memTask, 1000000, PRIO_BACKGROUND);
+  scheduler.addPeriodic("power", powerTask, 100000, PRIO_BACKGROUND);
+  autoTaskId = scheduler.addPeriodic("auto", autoTask, AUTO_PERIOD_MS * 1000, PRIO_CONTROL);
+  scheduler.setEnabled(autoTaskId, false);
 }
 
 void setup() {
   Serial.begin(115200);
+  LOGI(EV_BOOT);
 
   pinMode(motorA_pwm_fwd, OUTPUT);
   pinMode(motorA_pwm_rev, OUTPUT);
@@ -445,9 +1347,16 @@ void setup() {
   pinMode(motorB_pwm_right, OUTPUT);
   pinMode(motor_stby, OUTPUT);
   motorEnable(false); // motors off at boot
+
+  prefs.begin("car", false);
+  params.load(prefs);
+  loadTrajectory();
+
   setupPWM();
+  setupSpeedControl();
 
   connectToWiFi();
+  setupEmergencyStop(); // 連上 WiFi 後才監聽斷線，避免開機就鎖住
   ArduinoOTA.setPassword("mysecurepassword");
   ArduinoOTA.begin();
 
@@ -462,17 +1371,27 @@ void setup() {
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
     request->send(200, "text/html", index_html);
   });
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/params", HTTP_GET, handleParamsGet);
+  server.on("/params", HTTP_POST, handleParamsPost);
+  server.on("/trajectory", HTTP_POST, handleTrajectoryPost, nullptr, handleTrajectoryBody);
   server.begin();
 
   webSocket.begin();
   webSocket.onEvent(webSocketEvent);
+  webSocket.enableHeartbeat(ESTOP_PING_INTERVAL_MS, ESTOP_PONG_TIMEOUT_MS, 2);
 
   Serial.println("Web UI: http://" + WiFi.localIP().toString());
   Serial.println("WebSocket: ws://" + WiFi.localIP().toString() + ":81");
+
+  setupTasks();
+  setupPower();
 }
 
 void loop() {
-  ArduinoOTA.handle();
-  webSocket.loop();
-  //handleMotorRamping(); // 處理馬達漸進
+  uint32_t idleUs = scheduler.runDue();
+  if (idleUs >= 1000) {
+    // 沒事做時讓出 CPU 給 WiFi / idle task；PARKED 時睡到下一個 deadline，讓 light sleep 有機會進去
+    delay(idlePower.state() == POWER_PARKED ? idleUs / 1000 : 1);
+  }
 }
@@ -0,0 +1,132 @@
+// BleMidiPacket 主機測試：header / ts byte 的時間戳切法、running status、
+// 同時間戳省略 ts byte、127 ms 跨度上限與 maxLen 截斷。
+#include <unity.h>
+#include <BleMidiPacket.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_first_message_has_header_and_timestamp() {
+  BleMidiPacket p;
+  TEST_ASSERT_TRUE(p.empty());
+  // 0x1234 = 4660 ms：高 6 bits (bit 7..12) = 0x24，低 7 bits = 0x34
+  TEST_ASSERT_TRUE(p.noteOn(0x1234, 2, 60, 100));
+  const uint8_t expected[] = { 0x80 | 0x24, 0x80 | 0x34, 0x92, 60, 100 };
+  TEST_ASSERT_EQUAL(sizeof(expected), p.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, p.data(), sizeof(expected));
+  TEST_ASSERT_EQUAL(1, p.messages());
+}
+
+void test_timestamp_wraps_at_13_bits() {
+  BleMidiPacket p;
+  TEST_ASSERT_TRUE(p.noteOn(8192 + 5, 0, 60, 1));
+  TEST_ASSERT_EQUAL_HEX8(0x80, p.data()[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x85, p.data()[1]);
+}
+
+void test_running_status_and_same_time_elision() {
+  BleMidiPacket p;
+  p.noteOn(100, 0, 60, 90);
+  TEST_ASSERT_TRUE(p.noteOn(100, 0, 64, 90));  // 同 status 同時間：只有資料
+  TEST_ASSERT_TRUE(p.noteOn(103, 0, 67, 90));  // 同 status 新時間：ts + 資料
+  TEST_ASSERT_TRUE(p.noteOff(103, 0, 60));     // note off 送成 vel 0 note on，同時間
+  TEST_ASSERT_TRUE(p.noteOn(104, 1, 72, 80));  // 換 status：ts + status + 資料
+  const uint8_t expected[] = {
+    0x80, 0x80 | 100, 0x90, 60, 90,
+    64, 90,
+    0x80 | 103, 67, 90,
+    60, 0,
+    0x80 | 104, 0x91, 72, 80,
+  };
+  TEST_ASSERT_EQUAL(sizeof(expected), p.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, p.data(), sizeof(expected));
+  TEST_ASSERT_EQUAL(5, p.messages());
+}
+
+void test_new_status_at_same_time_keeps_timestamp() {
+  BleMidiPacket p;
+  p.noteOn(10, 0, 60, 90);
+  TEST_ASSERT_TRUE(p.add(10, 0xB0, 7, 100));
+  const uint8_t expected[] = { 0x80, 0x80 | 10, 0x90, 60, 90, 0x80 | 10, 0xB0, 7, 100 };
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, p.data(), sizeof(expected));
+}
+
+void test_low_byte_wraps_once_inside_packet() {
+  BleMidiPacket p;
+  p.noteOn(120, 0, 60, 90);
+  TEST_ASSERT_TRUE(p.noteOn(130, 0, 62, 90));
+  TEST_ASSERT_EQUAL_HEX8(0x80 | (130 & 0x7F), p.data()[5]);
+  TEST_ASSERT_EQUAL_HEX8(0x80, p.data()[0]);  // header 仍是第一則的高位
+}
+
+void test_span_limit_127ms() {
+  BleMidiPacket p(64);
+  p.noteOn(1000, 0, 60, 90);
+  TEST_ASSERT_TRUE(p.noteOn(1127, 0, 62, 90));
+  uint8_t size = p.size();
+  TEST_ASSERT_FALSE(p.noteOn(1128, 0, 64, 90));
+  TEST_ASSERT_EQUAL(size, p.size());
+  TEST_ASSERT_EQUAL(2, p.messages());
+}
+
+void test_earlier_timestamp_clamped_to_last() {
+  BleMidiPacket p;
+  p.noteOn(500, 0, 60, 90);
+  TEST_ASSERT_TRUE(p.noteOn(490, 0, 62, 90));  // 不能倒退：視為同時間
+  TEST_ASSERT_EQUAL(7, p.size());
+}
+
+void test_max_len_cut_off() {
+  BleMidiPacket p;  // 預設 20 bytes
+  uint8_t added = 0;
+  while (p.noteOn(added, 0, 60 + added, 90)) added++;
+  // 5 (第一則) + 每則 3 bytes：5 + 5 * 3 = 20
+  TEST_ASSERT_EQUAL(6, added);
+  TEST_ASSERT_EQUAL(20, p.size());
+  // 滿了：連只要 2 bytes 的同時間 running status 也放不下
+  TEST_ASSERT_FALSE(p.noteOn(added - 1, 0, 100, 90));
+
+  BleMidiPacket q(6);
+  q.noteOn(0, 0, 60, 90);
+  TEST_ASSERT_FALSE(q.noteOn(1, 0, 62, 90));  // 需要 3 bytes，只剩 1
+  TEST_ASSERT_FALSE(q.noteOn(0, 0, 62, 90));  // 同時間也要 2 bytes
+  TEST_ASSERT_EQUAL(5, q.size());
+}
+
+void test_max_len_clamped() {
+  BleMidiPacket p(255);
+  uint8_t added = 0;
+  while (p.noteOn(0, 0, added, 90)) added++;
+  // 上限 64：5 + 29 則同時間 running status * 2 bytes = 63
+  TEST_ASSERT_EQUAL(30, added);
+  TEST_ASSERT_EQUAL(63, p.size());
+}
+
+void test_due_and_clear() {
+  BleMidiPacket p;
+  TEST_ASSERT_FALSE(p.due(1000, 7));
+  p.noteOn(1000, 0, 60, 90);
+  TEST_ASSERT_FALSE(p.due(1006, 7));
+  TEST_ASSERT_TRUE(p.due(1007, 7));
+  p.clear();
+  TEST_ASSERT_TRUE(p.empty());
+  TEST_ASSERT_FALSE(p.due(2000, 7));
+  // clear 後 running status 重新開始：第一則一定帶 status
+  p.noteOn(2000, 0, 60, 90);
+  TEST_ASSERT_EQUAL_HEX8(0x90, p.data()[2]);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_message_has_header_and_timestamp);
+  RUN_TEST(test_timestamp_wraps_at_13_bits);
+  RUN_TEST(test_running_status_and_same_time_elision);
+  RUN_TEST(test_new_status_at_same_time_keeps_timestamp);
+  RUN_TEST(test_low_byte_wraps_once_inside_packet);
+  RUN_TEST(test_span_limit_127ms);
+  RUN_TEST(test_earlier_timestamp_clamped_to_last);
+  RUN_TEST(test_max_len_cut_off);
+  RUN_TEST(test_max_len_clamped);
+  RUN_TEST(test_due_and_clear);
+  return UNITY_END();
+}
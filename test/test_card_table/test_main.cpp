@@ -0,0 +1,116 @@
+// CardTable 主機測試與查詢基準：pio test -e native -f test_card_table -v
+#include <unity.h>
+#include <CardTable.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static std::vector<CardEntry> makeCards(size_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<CardEntry> cards(count);
+  for (size_t i = 0; i < count; i++) {
+    CardEntry &e = cards[i];
+    e.uidLen = (i % 3 == 0) ? 7 : 4;
+    for (uint8_t b = 0; b < CARD_UID_MAX; b++) e.uid[b] = b < e.uidLen ? (uint8_t)rng() : 0;
+    e.role = 1 + i % 3;
+  }
+  std::sort(cards.begin(), cards.end(), [](const CardEntry &a, const CardEntry &b) {
+    return CardTable::cardCompare(a, b.uid, b.uidLen) < 0;
+  });
+  cards.erase(std::unique(cards.begin(), cards.end(), [](const CardEntry &a, const CardEntry &b) {
+    return CardTable::cardCompare(a, b.uid, b.uidLen) == 0;
+  }), cards.end());
+  return cards;
+}
+
+// 對照組：同一份排序好的陣列直接二分搜尋
+static const CardEntry *sortedFind(const std::vector<CardEntry> &cards, const uint8_t *uid, uint8_t uidLen) {
+  auto it = std::lower_bound(cards.begin(), cards.end(), 0, [&](const CardEntry &e, int) {
+    return CardTable::cardCompare(e, uid, uidLen) < 0;
+  });
+  if (it == cards.end() || CardTable::cardCompare(*it, uid, uidLen) != 0) return nullptr;
+  return &*it;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_rejects_unsorted() {
+  std::vector<CardEntry> cards = makeCards(16, 1);
+  std::swap(cards[3], cards[4]);
+  CardTable table;
+  TEST_ASSERT_FALSE(table.begin(cards.data(), cards.size()));
+  TEST_ASSERT_EQUAL(0, table.size());
+}
+
+void test_finds_every_card_and_no_others() {
+  std::vector<CardEntry> cards = makeCards(1000, 2);
+  CardTable table;
+  TEST_ASSERT_TRUE(table.begin(cards.data(), cards.size()));
+  TEST_ASSERT_TRUE(table.indexed());
+  for (const CardEntry &e : cards) {
+    TEST_ASSERT_TRUE(table.find(e.uid, e.uidLen) == &e);
+  }
+  // 不在表裡的 UID（同長度、隨機內容，先用 std::binary_search 確認真的不在）
+  std::mt19937 rng(3);
+  int absent = 0;
+  while (absent < 1000) {
+    uint8_t uid[CARD_UID_MAX] = {};
+    uint8_t len = (absent % 2) ? 7 : 4;
+    for (uint8_t b = 0; b < len; b++) uid[b] = (uint8_t)rng();
+    if (sortedFind(cards, uid, len)) continue;
+    TEST_ASSERT_NULL(table.find(uid, len));
+    TEST_ASSERT_EQUAL(CARD_NONE, table.roleOf(uid, len));
+    absent++;
+  }
+  TEST_ASSERT_NULL(table.find(cards[0].uid, 0));
+}
+
+// 10k ~ 60k 張卡：hash 索引要比同大小的二分搜尋快（查詢順序打亂，兩邊查同一批 UID）
+void test_lookup_benchmark() {
+  const size_t sizes[] = { 10000, 20000, 40000, 60000 };
+  const int rounds = 20;
+
+  for (size_t n : sizes) {
+    std::vector<CardEntry> cards = makeCards(n, (uint32_t)n);
+    CardTable table;
+    TEST_ASSERT_TRUE(table.begin(cards.data(), cards.size()));
+    TEST_ASSERT_TRUE(table.indexed());
+
+    std::vector<const CardEntry *> queries;
+    for (const CardEntry &e : cards) queries.push_back(&e);
+    std::shuffle(queries.begin(), queries.end(), std::mt19937((uint32_t)n));
+
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (const CardEntry *e : queries) hits += table.find(e->uid, e->uidLen) != nullptr;
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (const CardEntry *e : queries) hits += sortedFind(cards, e->uid, e->uidLen) != nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+    TEST_ASSERT_EQUAL(2 * rounds * cards.size(), hits);
+
+    double lookups = (double)rounds * cards.size();
+    double hashNs = std::chrono::duration<double, std::nano>(mid - start).count() / lookups;
+    double bsearchNs = std::chrono::duration<double, std::nano>(end - mid).count() / lookups;
+
+    char line[96];
+    snprintf(line, sizeof(line), "%6u cards: %.1f ns/lookup (binary search %.1f ns)",
+             (unsigned)cards.size(), hashNs, bsearchNs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(hashNs < bsearchNs);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_rejects_unsorted);
+  RUN_TEST(test_finds_every_card_and_no_others);
+  RUN_TEST(test_lookup_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,301 @@
+// 指令 -> 輸出延遲的主機測試。
+// 指令邏輯是韌體本身的 CommandPath（緊急停止檢查、寫輸出、閉迴路延到 speedTask 之後
+// 才回報 seq、superseded、LatencyStats）；task 配置照 main.cpp（estop 1 ms、ws 1 ms、
+// speed 10 ms、背景長 task）跑在 CoopScheduler + 假時鐘上。
+// 成本是模型：WebSocketsServer / AsyncTCP / ArduinoJson 沒有 Linux 版，JSON 解析與
+// 對每個 client 廣播的時間用下面的常數代替，網路端的延遲不在量測範圍內。
+#include <unity.h>
+#include <CommandPath.h>
+#include <CoopScheduler.h>
+#include <EmergencyStop.h>
+#include <LatencyStats.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+static const uint8_t PRIO_SAFETY = 4;
+static const uint8_t PRIO_CONTROL = 3;
+static const uint8_t PRIO_NETWORK = 2;
+static const uint8_t PRIO_BACKGROUND = 1;
+static const uint32_t ESTOP_PERIOD_US = 1000;
+static const uint32_t WS_PERIOD_US = 1000;
+static const uint32_t SPEED_PERIOD_US = 10000;
+static const uint32_t BG_PERIOD_US = 100000;
+static const uint32_t BG_COST_US = 3000;          // 例如 /metrics 序列化
+static const uint32_t PARSE_COST_US = 120;        // 模型：deserializeJson
+static const uint32_t BROADCAST_COST_US = 60;     // 模型：每個 client 一次 sendTXT
+static const size_t RX_QUEUE = 16;                // 一次 poll 之間 TCP 能暫存的 frame
+
+static uint32_t fakeNowUs = 0;
+static uint32_t fakeClock() { return fakeNowUs; }
+
+struct Frame {
+  uint32_t arriveUs;
+  uint32_t seq;
+  int16_t steer;
+  int16_t throttle;
+};
+
+// 硬體端：記下寫到「PWM」的值與廣播
+struct Hw {
+  int dutyA = 0;
+  int dutyB = 0;
+  bool stby = false;
+  bool closedLoop = true;
+  bool released = true;   // 緊急停止按鈕
+  int setpointA = 0;      // 閉迴路時 speedTask 才寫到 dutyA
+  uint32_t statusCount = 0;
+  uint32_t lastSeq = 0;
+  int lastMotorA = 0;
+};
+
+static Hw hw;
+static uint8_t clients = 1;
+static std::deque<Frame> rx;
+static uint32_t dropped = 0;
+
+static void hwDriveA(int throttle) {
+  hw.setpointA = throttle;
+  if (!hw.closedLoop || throttle == 0) hw.dutyA = throttle;
+}
+static void hwDriveB(int steer) { hw.dutyB = steer; }
+static void hwEnable(bool on) { hw.stby = on; }
+static bool hwDeferA() { return hw.closedLoop; }
+static void hwStatus(int motorA, int motorB, uint32_t seq) {
+  fakeNowUs += BROADCAST_COST_US * clients;
+  hw.statusCount++;
+  hw.lastMotorA = motorA;
+  hw.lastSeq = seq;
+}
+
+static const CommandOutputs OUTPUTS = { hwDriveA, hwDriveB, hwEnable, hwDeferA, hwStatus };
+static EmergencyStop estop;
+static CommandPath *path = nullptr;
+
+static void wsTask(void *) {
+  while (!rx.empty()) {
+    Frame f = rx.front();
+    rx.pop_front();
+    fakeNowUs += PARSE_COST_US;
+    path->joystick(f.steer, f.throttle, f.seq, f.arriveUs, hw.released, fakeNowUs);
+  }
+}
+
+static void speedTask(void *) {
+  fakeNowUs += 40;  // 讀編碼器 + PID
+  if (hw.closedLoop) hw.dutyA = hw.setpointA;
+  path->outputApplied(fakeNowUs);
+}
+
+static void idleTask(void *) {}
+static void bgTask(void *) { fakeNowUs += BG_COST_US; }
+
+// 跑 durationUs；每個 driver 以 rateHz 送 frame（各自隨機相位與 ±10% 抖動）
+static void runDrivers(uint8_t clients, uint8_t drivers, uint32_t rateHz, uint32_t durationUs, uint32_t seed) {
+  CoopScheduler s;
+  s.addPeriodic("estop", idleTask, ESTOP_PERIOD_US, PRIO_SAFETY);
+  s.addPeriodic("speed", speedTask, SPEED_PERIOD_US, PRIO_CONTROL);
+  s.addPeriodic("ws", wsTask, WS_PERIOD_US, PRIO_NETWORK);
+  s.addPeriodic("bg", bgTask, BG_PERIOD_US, PRIO_BACKGROUND, nullptr, 10000);
+  ::clients = clients;
+
+  std::mt19937 rng(seed);
+  uint32_t periodUs = 1000000 / rateHz;
+  std::vector<uint32_t> next(drivers);
+  uint32_t seq = 0;
+  for (uint8_t d = 0; d < drivers; d++) next[d] = fakeNowUs + rng() % periodUs;
+
+  uint32_t end = fakeNowUs + durationUs;
+  while ((int32_t)(end - fakeNowUs) > 0) {
+    // frame 在 runDue() 之間抵達（task 執行中抵達的，等下一次 poll 才看得到）
+    for (uint8_t d = 0; d < drivers; d++) {
+      while ((int32_t)(fakeNowUs - next[d]) >= 0) {
+        if (rx.size() < RX_QUEUE) {
+          rx.push_back({ next[d], ++seq, 0, (int16_t)(1 + rng() % 100) });
+        } else {
+          dropped++;
+        }
+        next[d] += periodUs - periodUs / 10 + rng() % (periodUs / 5);
+      }
+    }
+    uint32_t before = fakeNowUs;
+    s.runDue();
+    if (fakeNowUs == before) fakeNowUs += 50;  // loop 的 delay
+  }
+}
+
+void setUp() {
+  fakeNowUs = 1000;
+  hw = Hw();
+  clients = 1;
+  rx.clear();
+  dropped = 0;
+  estop = EmergencyStop();
+  delete path;
+  path = new CommandPath(estop, OUTPUTS);
+  CoopScheduler::setClock(fakeClock);
+}
+void tearDown() { CoopScheduler::setClock(nullptr); }
+
+void test_open_loop_reports_immediately() {
+  hw.closedLoop = false;
+  TEST_ASSERT_TRUE(path->joystick(10, 50, 7, 900, true, 1000));
+  TEST_ASSERT_EQUAL(50, hw.dutyA);
+  TEST_ASSERT_EQUAL(10, hw.dutyB);
+  TEST_ASSERT_TRUE(hw.stby);
+  TEST_ASSERT_FALSE(path->pending());
+  TEST_ASSERT_EQUAL(1, hw.statusCount);
+  TEST_ASSERT_EQUAL(7, hw.lastSeq);
+  TEST_ASSERT_EQUAL(1, path->latency().count());
+  TEST_ASSERT_EQUAL(100, path->latency().maxUs());
+}
+
+void test_closed_loop_seq_echoed_after_output_applied() {
+  TEST_ASSERT_TRUE(path->joystick(0, 50, 7, 1000, true, 1100));
+  TEST_ASSERT_TRUE(path->pending());
+  TEST_ASSERT_EQUAL(0, hw.statusCount);
+  TEST_ASSERT_EQUAL(0, hw.dutyA);   // PWM 還沒寫
+  speedTask(nullptr);               // fakeNowUs 1000 -> 1040
+  TEST_ASSERT_EQUAL(50, hw.dutyA);
+  TEST_ASSERT_FALSE(path->pending());
+  TEST_ASSERT_EQUAL(1, hw.statusCount);
+  TEST_ASSERT_EQUAL(7, hw.lastSeq);
+  TEST_ASSERT_EQUAL(40, path->latency().maxUs());
+  // 沒有等待中的指令時不再廣播
+  speedTask(nullptr);
+  TEST_ASSERT_EQUAL(1, hw.statusCount);
+}
+
+void test_stop_frame_supersedes_pending_and_reports_now() {
+  path->joystick(0, 50, 1, 1000, true, 1000);
+  path->joystick(0, 60, 2, 1000, true, 1000);
+  TEST_ASSERT_EQUAL(1, path->superseded());
+  TEST_ASSERT_TRUE(path->joystick(0, 0, 3, 1000, true, 1200));
+  TEST_ASSERT_EQUAL(2, path->superseded());
+  TEST_ASSERT_FALSE(path->pending());
+  TEST_ASSERT_FALSE(hw.stby);
+  TEST_ASSERT_EQUAL(0, hw.dutyA);
+  TEST_ASSERT_EQUAL(1, hw.statusCount);
+  TEST_ASSERT_EQUAL(3, hw.lastSeq);
+  TEST_ASSERT_EQUAL(3, path->accepted());
+  TEST_ASSERT_EQUAL(1, path->latency().count());
+}
+
+void test_internal_control_has_no_seq() {
+  path->joystick(0, 50, 5, 1000, true, 1000);
+  path->control(0, 0, 1000);  // 例如 watchdog 停車
+  TEST_ASSERT_EQUAL(1, path->superseded());
+  TEST_ASSERT_EQUAL(1, hw.statusCount);
+  TEST_ASSERT_EQUAL(0, hw.lastSeq);
+  TEST_ASSERT_EQUAL(0, path->latency().count());
+  TEST_ASSERT_EQUAL(1, path->accepted());
+}
+
+void test_estop_rejects_until_centered_and_released() {
+  path->joystick(0, 50, 1, 1000, true, 1000);
+  speedTask(nullptr);
+  estop.request(1, fakeNowUs);
+  TEST_ASSERT_FALSE(path->joystick(0, 50, 2, 1000, true, 1100));  // pending
+  estop.complete(fakeNowUs);
+  hw.released = false;
+  TEST_ASSERT_FALSE(path->joystick(0, 0, 3, 1000, hw.released, 1100));  // 按鈕還按著
+  hw.released = true;
+  TEST_ASSERT_FALSE(path->joystick(0, 50, 4, 1000, hw.released, 1100));  // 沒回中
+  TEST_ASSERT_FALSE(path->joystick(0, 0, 5, 1000, hw.released, 1100));   // 解除，本身仍拒絕
+  TEST_ASSERT_FALSE(estop.latched());
+  TEST_ASSERT_EQUAL(4, path->rejected());
+  TEST_ASSERT_EQUAL(1, hw.statusCount);   // 被擋下的 frame 不廣播也不改輸出
+  TEST_ASSERT_EQUAL(50, path->motorA());
+  TEST_ASSERT_TRUE(path->joystick(0, 0, 6, 1000, hw.released, 1100));
+  TEST_ASSERT_EQUAL(6, hw.lastSeq);
+}
+
+void test_histogram_percentiles_match_exact() {
+  LatencyStats h;
+  std::mt19937 rng(5);
+  std::vector<uint32_t> v;
+  for (int i = 0; i < 20000; i++) {
+    uint32_t us = 200 + rng() % 12000 + (rng() % 100 == 0 ? 40000 : 0);
+    v.push_back(us);
+    h.record(us);
+  }
+  std::sort(v.begin(), v.end());
+  const uint8_t ps[] = { 50, 90, 99 };
+  for (uint8_t p : ps) {
+    uint32_t exact = v[(v.size() * p + 99) / 100 - 1];
+    uint32_t got = h.percentile(p);
+    TEST_ASSERT_TRUE(got >= exact);
+    TEST_ASSERT_TRUE(got <= exact + exact / 4 + 1);
+  }
+  TEST_ASSERT_EQUAL(v.back(), h.maxUs());
+  TEST_ASSERT_EQUAL(v.back(), h.percentile(100));
+  TEST_ASSERT_EQUAL(20000, h.count());
+}
+
+void test_histogram_buckets_are_contiguous() {
+  for (uint8_t b = 1; b < LatencyStats::BUCKETS; b++) {
+    TEST_ASSERT_EQUAL(b, LatencyStats::bucketOf(LatencyStats::bucketUpper(b - 1) + 1));
+    TEST_ASSERT_EQUAL(b, LatencyStats::bucketOf(LatencyStats::bucketUpper(b)));
+  }
+  TEST_ASSERT_EQUAL(LatencyStats::BUCKETS - 1, LatencyStats::bucketOf(UINT32_MAX));
+  LatencyStats h;
+  TEST_ASSERT_EQUAL(0, h.percentile(99));
+}
+
+void test_closed_loop_latency_bounded_by_speed_period() {
+  runDrivers(1, 1, 50, 20000000, 1);
+  const LatencyStats &latency = path->latency();
+  TEST_ASSERT_EQUAL(0, dropped);
+  TEST_ASSERT_TRUE(path->accepted() >= 990 && path->accepted() <= 1010);
+  // 最壞：剛錯過 speedTask，再被背景 task 擋住
+  uint32_t bound = SPEED_PERIOD_US + WS_PERIOD_US + BG_COST_US + 1000;
+  TEST_ASSERT_TRUE(latency.maxUs() <= bound);
+  // 平均約半個 speed 週期
+  TEST_ASSERT_TRUE(latency.percentile(50) > 2000 && latency.percentile(50) < 8000);
+}
+
+void test_throughput_and_latency_sweep() {
+  // 5 個 client（WebSocketsServer 預設上限）都在送 100 Hz，ws task 仍然跟得上
+  uint32_t lastP99 = 0;
+  for (uint8_t n = 1; n <= 5; n++) {
+    setUp();
+    runDrivers(n, n, 100, 5000000, n);
+    const LatencyStats &latency = path->latency();
+    char msg[128];
+    snprintf(msg, sizeof(msg), "clients=%u accepted/s=%u p99=%uus max=%uus dropped=%u superseded=%u", n,
+             (unsigned)(path->accepted() / 5), (unsigned)latency.percentile(99),
+             (unsigned)latency.maxUs(), (unsigned)dropped, (unsigned)path->superseded());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, dropped);
+    TEST_ASSERT_TRUE(path->accepted() / 5 >= 100u * n - 5);
+    TEST_ASSERT_EQUAL(path->accepted(), latency.count() + path->superseded() + (path->pending() ? 1 : 0));
+    TEST_ASSERT_TRUE(latency.percentile(99) <= SPEED_PERIOD_US + WS_PERIOD_US + BG_COST_US + 1000);
+    lastP99 = latency.percentile(99);
+  }
+  TEST_ASSERT_TRUE(lastP99 > 0);
+}
+
+void test_overload_drops_instead_of_growing_latency() {
+  // 每筆 frame 處理 + 廣播 5 個 client = 420 us；5 個 client 各 1 kHz 超過 loop 能處理的量
+  runDrivers(5, 5, 1000, 2000000, 9);
+  TEST_ASSERT_TRUE(dropped > 0);
+  // 佇列有上限，延遲不會無限制地累積
+  TEST_ASSERT_TRUE(path->latency().maxUs() < RX_QUEUE * (PARSE_COST_US + 5 * BROADCAST_COST_US) + SPEED_PERIOD_US + BG_COST_US + 2000);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_percentiles_match_exact);
+  RUN_TEST(test_histogram_buckets_are_contiguous);
+  RUN_TEST(test_open_loop_reports_immediately);
+  RUN_TEST(test_closed_loop_seq_echoed_after_output_applied);
+  RUN_TEST(test_stop_frame_supersedes_pending_and_reports_now);
+  RUN_TEST(test_internal_control_has_no_seq);
+  RUN_TEST(test_estop_rejects_until_centered_and_released);
+  RUN_TEST(test_closed_loop_latency_bounded_by_speed_period);
+  RUN_TEST(test_throughput_and_latency_sweep);
+  RUN_TEST(test_overload_drops_instead_of_growing_latency);
+  return UNITY_END();
+}
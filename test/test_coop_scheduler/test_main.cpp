@@ -0,0 +1,143 @@
+// CoopScheduler 主機測試：假時鐘（us）驗證優先序、相位不漂移、missed/overrun 統計，
+// 以及超過 71 分鐘（uint32 us 繞回）之後 loadPermille 仍正確
+#include <unity.h>
+#include <CoopScheduler.h>
+
+#include <vector>
+
+static uint32_t fakeNowUs = 0;
+static uint32_t fakeClock() { return fakeNowUs; }
+
+struct Probe {
+  const char *name;
+  uint32_t costUs;            // 每次執行推進假時鐘多少
+  std::vector<uint32_t> at;   // 每次開始執行的時間
+};
+
+static std::vector<const char *> order;
+
+static void probeTask(void *ctx) {
+  Probe *p = (Probe *)ctx;
+  p->at.push_back(fakeNowUs);
+  order.push_back(p->name);
+  fakeNowUs += p->costUs;
+}
+
+void setUp() {
+  // 從接近繞回的地方開始，順便驗證差值比較
+  fakeNowUs = 0xFFFFFFFFu - 5000000u;
+  order.clear();
+  CoopScheduler::setClock(fakeClock);
+}
+void tearDown() { CoopScheduler::setClock(nullptr); }
+
+// 以 stepUs 推進時鐘並呼叫 runDue()，模擬 loop()
+static void runFor(CoopScheduler &s, uint64_t durationUs, uint32_t stepUs) {
+  uint64_t done = 0;
+  while (done < durationUs) {
+    uint32_t before = fakeNowUs;
+    s.runDue();
+    uint32_t used = fakeNowUs - before;
+    uint32_t adv = used < stepUs ? stepUs - used : 0;
+    fakeNowUs += adv;
+    done += used + adv;
+  }
+}
+
+void test_higher_priority_runs_first() {
+  CoopScheduler s;
+  Probe lo = { "lo", 0, {} }, hi = { "hi", 0, {} }, mid = { "mid", 0, {} };
+  s.addPeriodic("lo", probeTask, 1000, 1, &lo);
+  s.addPeriodic("hi", probeTask, 1000, 4, &hi);
+  s.addPeriodic("mid", probeTask, 1000, 2, &mid);
+  fakeNowUs += 1000;
+  s.runDue();
+  TEST_ASSERT_EQUAL(3, order.size());
+  TEST_ASSERT_EQUAL_STRING("hi", order[0]);
+  TEST_ASSERT_EQUAL_STRING("mid", order[1]);
+  TEST_ASSERT_EQUAL_STRING("lo", order[2]);
+}
+
+void test_period_keeps_phase_under_late_calls() {
+  CoopScheduler s;
+  Probe p = { "p", 0, {} };
+  uint32_t start = fakeNowUs;
+  s.addPeriodic("p", probeTask, 1000, 3, &p);
+  // 週期 task 註冊後立刻到期；loop 每 300 us 才醒一次，開始時間會晚，
+  // 但 deadline 仍落在 start + 1000 的倍數
+  runFor(s, 100000, 300);
+  TEST_ASSERT_TRUE(p.at.size() >= 100);
+  for (size_t i = 0; i < p.at.size(); i++) {
+    uint32_t late = p.at[i] - (start + (uint32_t)i * 1000);
+    TEST_ASSERT_TRUE(late < 300);
+  }
+}
+
+void test_missed_periods_and_overruns_counted() {
+  CoopScheduler s;
+  Probe fast = { "fast", 0, {} }, slow = { "slow", 3500, {} };
+  int fastId = s.addPeriodic("fast", probeTask, 1000, 3, &fast);
+  int slowId = s.addPeriodic("slow", probeTask, 10000, 1, &slow, 2000);
+  runFor(s, 100000, 100);
+
+  TaskInfo fi, si;
+  TEST_ASSERT_TRUE(s.taskInfo(fastId, fi));
+  TEST_ASSERT_TRUE(s.taskInfo(slowId, si));
+  // slow 每次佔 3.5 ms，fast 會錯過週期而不是連跑補回
+  TEST_ASSERT_TRUE(fi.stats->missed > 0);
+  TEST_ASSERT_EQUAL(si.stats->runs, si.stats->overruns);
+  TEST_ASSERT_EQUAL(3500, si.stats->maxUs);
+  TEST_ASSERT_TRUE(fi.stats->maxLateUs <= 3500 + 100);
+  TEST_ASSERT_TRUE(fast.at.size() + fi.stats->missed >= 99);
+}
+
+void test_one_shot_runs_once_and_trigger_reschedules() {
+  CoopScheduler s;
+  Probe p = { "once", 0, {} };
+  int id = s.addOneShot("once", probeTask, 5000, 2, &p);
+  runFor(s, 20000, 100);
+  TEST_ASSERT_EQUAL(1, p.at.size());
+  TEST_ASSERT_EQUAL(0, s.taskCount());
+
+  Probe q = { "q", 0, {} };
+  id = s.addPeriodic("q", probeTask, 1000000, 2, &q);
+  s.trigger(id);
+  s.runDue();
+  TEST_ASSERT_EQUAL(1, q.at.size());
+}
+
+void test_load_permille_after_uint32_wrap() {
+  CoopScheduler s;
+  Probe p = { "load", 250, {} }; // 每 1 ms 佔 250 us = 25%
+  s.addPeriodic("load", probeTask, 1000, 2, &p);
+  s.resetStats();
+  // 75 分鐘，超過 uint32 us 的 71.6 分鐘
+  runFor(s, 75ULL * 60 * 1000000, 1000);
+  uint16_t load = s.loadPermille();
+  TEST_ASSERT_TRUE(load >= 245 && load <= 255);
+
+  // 沒跑 runDue() 的空檔也算進視窗
+  fakeNowUs += 60000000;
+  TEST_ASSERT_TRUE(s.loadPermille() < load);
+}
+
+void test_load_permille_reset() {
+  CoopScheduler s;
+  Probe p = { "busy", 900, {} };
+  s.addPeriodic("busy", probeTask, 1000, 2, &p);
+  runFor(s, 10000, 1000);
+  TEST_ASSERT_TRUE(s.loadPermille() > 800);
+  s.resetStats();
+  TEST_ASSERT_EQUAL(0, s.loadPermille());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_higher_priority_runs_first);
+  RUN_TEST(test_period_keeps_phase_under_late_calls);
+  RUN_TEST(test_missed_periods_and_overruns_counted);
+  RUN_TEST(test_one_shot_runs_once_and_trigger_reschedules);
+  RUN_TEST(test_load_permille_after_uint32_wrap);
+  RUN_TEST(test_load_permille_reset);
+  return UNITY_END();
+}
@@ -0,0 +1,172 @@
+// 緊急停止主機測試：假時鐘 + CoopScheduler，和 main.cpp 一樣的接法
+// （觸發時立刻切 STBY，PRIO_SAFETY 的 estop task 收尾），背景有一個會跑很久的 task。
+// 驗證：STBY 在觸發當下就關、收尾前控制迴圈開不回 STBY、
+// 最壞停止延遲 <= 最長 task 執行時間 + estop 週期。
+#include <unity.h>
+#include <CoopScheduler.h>
+#include <EmergencyStop.h>
+
+#include <random>
+
+static const uint8_t PRIO_SAFETY = 4;
+static const uint8_t PRIO_CONTROL = 3;
+static const uint8_t PRIO_BACKGROUND = 1;
+static const uint32_t ESTOP_PERIOD_US = 1000;
+static const uint32_t CONTROL_PERIOD_US = 1000;
+static const uint32_t LONG_PERIOD_US = 20000;
+static const uint32_t LONG_COST_US = 8000;  // 例如 NVS 寫入、JSON 序列化
+static const uint32_t LOOP_STEP_US = 100;   // loop() 兩次 runDue() 之間
+
+static uint32_t fakeNowUs = 0;
+static uint32_t fakeClock() { return fakeNowUs; }
+
+static EmergencyStop estop;
+static bool stby = false;           // 假的 STBY 腳位
+static int pwm = 0;
+static bool stbyHighWhilePending = false;
+static uint32_t fireAtUs = 0;       // 下一次「中斷」觸發的時間，0 = 不觸發
+static uint32_t requestedAtUs = 0;
+static bool stbyLowAtRequest = false;
+
+static void motorEnable(bool enable) {
+  if (enable && !estop.allowsEnable()) return;
+  stby = enable;
+}
+
+static void requestEmergencyStop(uint8_t source) {
+  stby = false;
+  estop.request(source, fakeNowUs);
+  requestedAtUs = fakeNowUs;
+  stbyLowAtRequest = !stby;
+}
+
+// 推進假時鐘；途中到了 fireAtUs 就像中斷一樣插進來觸發緊急停止
+static void advance(uint32_t us) {
+  uint32_t end = fakeNowUs + us;
+  if (fireAtUs && (int32_t)(fireAtUs - fakeNowUs) >= 0 && (int32_t)(end - fireAtUs) >= 0) {
+    fakeNowUs = fireAtUs;
+    fireAtUs = 0;
+    requestEmergencyStop(2);
+  }
+  fakeNowUs = end;
+}
+
+static void estopTask(void *) {
+  if (!estop.pending()) return;
+  pwm = 0;
+  motorEnable(false);
+  estop.complete(fakeNowUs);
+}
+
+// 模擬 speedTask：一直想輸出
+static void controlTask(void *) {
+  advance(50);
+  pwm = 120;
+  motorEnable(true);
+  if (estop.pending() && stby) stbyHighWhilePending = true;
+}
+
+static void longTask(void *) {
+  advance(LONG_COST_US);
+}
+
+static void loopFor(CoopScheduler &s, uint32_t durationUs) {
+  uint32_t end = fakeNowUs + durationUs;
+  while ((int32_t)(end - fakeNowUs) > 0) {
+    s.runDue();
+    advance(LOOP_STEP_US);
+  }
+}
+
+void setUp() {
+  fakeNowUs = 1000;
+  CoopScheduler::setClock(fakeClock);
+  estop = EmergencyStop();
+  stby = false;
+  pwm = 0;
+  stbyHighWhilePending = false;
+  fireAtUs = 0;
+}
+void tearDown() { CoopScheduler::setClock(nullptr); }
+
+static void addTasks(CoopScheduler &s) {
+  s.addPeriodic("estop", estopTask, ESTOP_PERIOD_US, PRIO_SAFETY);
+  s.addPeriodic("control", controlTask, CONTROL_PERIOD_US, PRIO_CONTROL);
+  s.addPeriodic("long", longTask, LONG_PERIOD_US, PRIO_BACKGROUND, nullptr, 10000);
+}
+
+void test_stop_latency_bounded_by_longest_task() {
+  CoopScheduler s;
+  addTasks(s);
+  loopFor(s, 50000);
+  TEST_ASSERT_TRUE(stby);
+
+  // 觸發時間掃過長 task 的整個週期（含長 task 剛開始跑的最壞情況）
+  std::mt19937 rng(7);
+  uint32_t worst = 0;
+  for (int i = 0; i < 400; i++) {
+    fireAtUs = fakeNowUs + 1000 + rng() % LONG_PERIOD_US;
+    loopFor(s, LONG_PERIOD_US + 2000);
+    TEST_ASSERT_EQUAL(0, fireAtUs);
+    loopFor(s, LONG_PERIOD_US);
+    TEST_ASSERT_TRUE(stbyLowAtRequest);
+    TEST_ASSERT_FALSE(estop.pending());
+    TEST_ASSERT_TRUE(estop.latched());
+    TEST_ASSERT_FALSE(stby);
+    if (estop.lastUs() > worst) worst = estop.lastUs();
+
+    TEST_ASSERT_FALSE(estop.allowsDrive(true, true)); // 回中那一 frame 只解鎖
+    TEST_ASSERT_TRUE(estop.allowsDrive(false, true));
+    loopFor(s, 5000);
+    TEST_ASSERT_TRUE(stby);
+  }
+  TEST_ASSERT_FALSE(stbyHighWhilePending);
+  TEST_ASSERT_EQUAL(400, estop.count());
+  TEST_ASSERT_EQUAL(worst, estop.maxUs());
+  TEST_ASSERT_TRUE(worst <= LONG_COST_US + ESTOP_PERIOD_US + LOOP_STEP_US);
+  // 有抽到長 task 正在跑的情況，確定上界真的被測到
+  TEST_ASSERT_TRUE(worst > ESTOP_PERIOD_US + LOOP_STEP_US);
+}
+
+void test_pending_refuses_drive_and_enable() {
+  motorEnable(true);
+  TEST_ASSERT_TRUE(stby);
+  requestEmergencyStop(1);
+  TEST_ASSERT_FALSE(stby);
+  TEST_ASSERT_TRUE(estop.pending());
+
+  motorEnable(true);
+  TEST_ASSERT_FALSE(stby);
+  TEST_ASSERT_FALSE(estop.allowsDrive(true, true));  // 收尾前連回中也不能解鎖
+  TEST_ASSERT_FALSE(estop.allowsDrive(false, true));
+
+  fakeNowUs += 300;
+  estopTask(nullptr);
+  TEST_ASSERT_EQUAL(300, estop.lastUs());
+  TEST_ASSERT_FALSE(estop.allowsDrive(true, false)); // 按鈕還按著
+  TEST_ASSERT_TRUE(estop.latched());
+  TEST_ASSERT_FALSE(estop.allowsDrive(true, true));
+  TEST_ASSERT_FALSE(estop.latched());
+  motorEnable(true);
+  TEST_ASSERT_TRUE(stby);
+}
+
+void test_repeated_requests_keep_first_source_and_time() {
+  requestEmergencyStop(3);
+  fakeNowUs += 100;
+  estop.request(4, fakeNowUs);
+  fakeNowUs += 100;
+  TEST_ASSERT_TRUE(estop.complete(fakeNowUs));
+  TEST_ASSERT_EQUAL(3, estop.source());
+  TEST_ASSERT_EQUAL(200, estop.lastUs());
+  TEST_ASSERT_FALSE(estop.complete(fakeNowUs));
+  TEST_ASSERT_EQUAL(1, estop.count());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stop_latency_bounded_by_longest_task);
+  RUN_TEST(test_pending_refuses_drive_and_enable);
+  RUN_TEST(test_repeated_requests_keep_first_source_and_time);
+  return UNITY_END();
+}
@@ -0,0 +1,55 @@
+// 閒置省電狀態機主機測試：狀態轉換與耗電估計，
+// 包含 light sleep 沒開起來時用 setCurrentMa() 修正 PARKED 的估計。
+#include <unity.h>
+#include <IdlePower.h>
+
+static const PowerProfile PROFILE = { 5000, 60000, { 80, 30, 5 } };
+
+void setUp() {}
+void tearDown() {}
+
+void test_states_follow_quiet_time() {
+  IdlePower p(PROFILE);
+  p.begin(0);
+  TEST_ASSERT_FALSE(p.update(4999, true));
+  TEST_ASSERT_TRUE(p.update(5000, true));
+  TEST_ASSERT_EQUAL(POWER_IDLE, p.state());
+  TEST_ASSERT_FALSE(p.update(60000, false));  // 有 client 時最多停在 IDLE
+  TEST_ASSERT_TRUE(p.update(60000, true));
+  TEST_ASSERT_EQUAL(POWER_PARKED, p.state());
+  TEST_ASSERT_TRUE(p.activity(61000));
+  TEST_ASSERT_EQUAL(POWER_ACTIVE, p.state());
+  TEST_ASSERT_FALSE(p.activity(61001));
+  TEST_ASSERT_EQUAL(3, p.transitions());
+  TEST_ASSERT_EQUAL(55000, p.timeInStateMs(POWER_IDLE, 61001));
+}
+
+void test_estimate_uses_profile_current() {
+  IdlePower p(PROFILE);
+  p.begin(0);
+  p.update(5000, true);   // 5 s ACTIVE 80 mA
+  p.update(60000, true);  // 55 s IDLE 30 mA
+  // 再 60 s PARKED 5 mA：(5*80 + 55*30 + 60*5) / 120
+  TEST_ASSERT_EQUAL(5, p.currentMa());
+  TEST_ASSERT_EQUAL((5 * 80 + 55 * 30 + 60 * 5) / 120, p.averageCurrentMa(120000));
+}
+
+void test_set_current_overrides_until_next_state() {
+  IdlePower p(PROFILE);
+  p.begin(0);
+  p.update(60000, true);  // 直接 PARKED
+  p.setCurrentMa(20, 60000);  // light sleep 沒開起來
+  TEST_ASSERT_EQUAL(20, p.currentMa());
+  TEST_ASSERT_EQUAL((60 * 80 + 60 * 20) / 120, p.averageCurrentMa(120000));
+  p.activity(120000);
+  TEST_ASSERT_EQUAL(80, p.currentMa());  // 回到 profile 的值
+  TEST_ASSERT_EQUAL((60 * 80 + 60 * 20 + 60 * 80) / 180, p.averageCurrentMa(180000));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_states_follow_quiet_time);
+  RUN_TEST(test_estimate_uses_profile_current);
+  RUN_TEST(test_set_current_overrides_until_next_state);
+  return UNITY_END();
+}
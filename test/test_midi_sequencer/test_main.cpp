@@ -0,0 +1,124 @@
+// MidiSequencer 主機測試：用假時鐘（us）模擬 loop() 週期與抖動，量 lateness / jitter
+#include <unity.h>
+#include <MidiSequencer.h>
+
+#include <random>
+#include <vector>
+
+struct Sent {
+  MidiEvent ev;
+  uint64_t atUs;
+};
+
+static uint64_t fakeNowUs = 0;
+static std::vector<Sent> sent;
+
+static void record(const MidiEvent &ev, void *) {
+  sent.push_back({ ev, fakeNowUs });
+}
+
+// 1 tick = 1 ms（bpm 60、每拍 1000 ticks）
+static const SongNote melody[] = {
+  {    0, 250, 64, 100 }, {  325, 250, 62, 100 }, {  650, 250, 60, 100 },
+  {  975, 500, 62, 100 }, { 1625, 250, 64, 100 }, { 1950, 250, 64, 100 },
+};
+static const Song melodySong = { melody, 6, 0, 1000, 60 };
+
+static const SongNote bass[] = { { 0, 1200, 48, 90 }, { 1300, 600, 43, 90 } };
+static const Song bassSong = { bass, 2, 1, 1000, 60 };
+
+void setUp() {
+  fakeNowUs = 1000000;
+  sent.clear();
+}
+void tearDown() {}
+
+// 以 periodUs 週期、0..jitterUs 隨機抖動呼叫 service()，直到播完
+static void runLoop(MidiSequencer &seq, uint32_t periodUs, uint32_t jitterUs, uint32_t seed) {
+  std::mt19937 rng(seed);
+  uint64_t next = fakeNowUs;
+  for (int guard = 0; seq.busy() && guard < 100000; guard++) {
+    next += periodUs;
+    fakeNowUs = next + (jitterUs ? rng() % jitterUs : 0);
+    seq.service(fakeNowUs);
+  }
+}
+
+void test_events_at_scheduled_times_without_drift() {
+  MidiSequencer seq(record);
+  uint64_t start = fakeNowUs;
+  TEST_ASSERT_EQUAL(0, seq.play(melodySong, start));
+  runLoop(seq, 1000, 0, 1);
+
+  TEST_ASSERT_EQUAL(12, sent.size());
+  for (const Sent &s : sent) {
+    // 排定時間只由開始時間與 tick 決定，不受 service 時間影響
+    TEST_ASSERT_EQUAL(0, (s.ev.dueUs - start) % 1000);
+    TEST_ASSERT_TRUE(s.atUs >= s.ev.dueUs);
+  }
+  // 最後一個 note off：1950 + 250 ticks
+  TEST_ASSERT_EQUAL(start + 2200000, sent.back().ev.dueUs);
+  TEST_ASSERT_EQUAL(0, sent.back().ev.velocity);
+}
+
+void test_lateness_bounded_by_service_period_and_jitter() {
+  const uint32_t period = 1000, jitter = 700;
+  MidiSequencer seq(record);
+  seq.play(melodySong, fakeNowUs);
+  seq.play(bassSong, fakeNowUs);
+  runLoop(seq, period, jitter, 42);
+
+  const SequencerStats &st = seq.stats();
+  TEST_ASSERT_EQUAL(16, st.events);
+  TEST_ASSERT_EQUAL(0, st.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL(period + jitter, st.maxLateUs);
+
+  // jitter = 相鄰事件間隔與排定間隔的差
+  uint32_t maxJitter = 0;
+  for (size_t i = 1; i < sent.size(); i++) {
+    int64_t actual = (int64_t)(sent[i].atUs - sent[i - 1].atUs);
+    int64_t planned = (int64_t)(sent[i].ev.dueUs - sent[i - 1].ev.dueUs);
+    uint32_t d = (uint32_t)(actual > planned ? actual - planned : planned - actual);
+    if (d > maxJitter) maxJitter = d;
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(period + jitter, maxJitter);
+}
+
+void test_output_is_time_ordered_with_note_off_first() {
+  // 同音連續：前一個 note off 與下一個 note on 同時，off 必須先送
+  static const SongNote repeat[] = { { 0, 100, 60, 100 }, { 100, 100, 60, 100 } };
+  static const Song repeatSong = { repeat, 2, 0, 1000, 60 };
+  MidiSequencer seq(record);
+  seq.play(repeatSong, fakeNowUs);
+  fakeNowUs += 500000; // loop 卡住很久，一次補送全部
+  seq.service(fakeNowUs);
+
+  TEST_ASSERT_EQUAL(4, sent.size());
+  for (size_t i = 1; i < sent.size(); i++) {
+    TEST_ASSERT_TRUE(sent[i - 1].ev.dueUs <= sent[i].ev.dueUs);
+  }
+  TEST_ASSERT_EQUAL(0, sent[1].ev.velocity);
+  TEST_ASSERT_EQUAL(100, sent[2].ev.velocity);
+}
+
+void test_stop_flushes_pending_note_off() {
+  MidiSequencer seq(record);
+  int voice = seq.play(bassSong, fakeNowUs);
+  fakeNowUs += 1000;
+  seq.service(fakeNowUs);
+  TEST_ASSERT_EQUAL(1, sent.size()); // note on
+
+  seq.stop(voice);
+  TEST_ASSERT_EQUAL(2, sent.size());
+  TEST_ASSERT_EQUAL(0, sent[1].ev.velocity);
+  TEST_ASSERT_FALSE(seq.busy());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_events_at_scheduled_times_without_drift);
+  RUN_TEST(test_lateness_bounded_by_service_period_and_jitter);
+  RUN_TEST(test_output_is_time_ordered_with_note_off_first);
+  RUN_TEST(test_stop_flushes_pending_note_off);
+  return UNITY_END();
+}
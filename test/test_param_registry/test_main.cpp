@@ -0,0 +1,92 @@
+// ParamRegistry 主機測試：整批套用 / 拒絕，以及 apply() 和另一個 thread 的 snapshot()
+// 同時進行時，讀到的一定是某一批完整的值（模擬 GET /params 在 async_tcp task 讀）。
+#include <unity.h>
+#include <ParamRegistry.h>
+
+#include <atomic>
+#include <thread>
+
+static const ParamDef DEFS[] = {
+  { "a", 0, 1000000, 1 },
+  { "b", 0, 1000000, 1 },
+  { "c", 0, 1000000, 1 },
+  { "d", 0, 1000000, 1 },
+  { "e", 0, 1000000, 1 },
+  { "f", 0, 1000000, 1 },
+};
+static const uint8_t COUNT = sizeof(DEFS) / sizeof(DEFS[0]);
+
+void setUp() {}
+void tearDown() {}
+
+void test_apply_is_all_or_nothing() {
+  ParamRegistry reg(DEFS, COUNT);
+  ParamUpdate ok[] = { { 0, 5 }, { 2, 7 } };
+  TEST_ASSERT_EQUAL(-1, reg.apply(ok, 2));
+  TEST_ASSERT_EQUAL(5, reg.get(0));
+  TEST_ASSERT_EQUAL(7, reg.get(2));
+  TEST_ASSERT_EQUAL((1 << 0) | (1 << 2), reg.changedMask());
+  uint32_t gen = reg.generation();
+
+  ParamUpdate bad[] = { { 1, 9 }, { 3, -1 } };
+  TEST_ASSERT_EQUAL(1, reg.apply(bad, 2));
+  TEST_ASSERT_EQUAL(1, reg.get(1));
+  TEST_ASSERT_EQUAL(gen, reg.generation());
+
+  ParamUpdate unknown[] = { { COUNT, 1 } };
+  TEST_ASSERT_EQUAL(0, reg.apply(unknown, 1));
+  TEST_ASSERT_EQUAL(-1, reg.find("zz"));
+  TEST_ASSERT_EQUAL(4, reg.find("e"));
+
+  int32_t snap[ParamRegistry::MAX_PARAMS];
+  reg.snapshot(snap);
+  TEST_ASSERT_EQUAL(5, snap[0]);
+  TEST_ASSERT_EQUAL(1, snap[1]);
+  TEST_ASSERT_EQUAL(7, snap[2]);
+
+  reg.resetDefaults();
+  TEST_ASSERT_EQUAL(1, reg.get(0));
+  TEST_ASSERT_EQUAL(1, reg.get(2));
+}
+
+void test_snapshot_never_sees_a_partial_batch() {
+  ParamRegistry reg(DEFS, COUNT);
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> reads{0}, torn{0};
+
+  // 讀的一方：每次都必須是同一批（所有值相等）
+  std::thread reader([&] {
+    int32_t snap[ParamRegistry::MAX_PARAMS];
+    int32_t last = 0;
+    while (!done.load()) {
+      reg.snapshot(snap);
+      for (uint8_t i = 1; i < COUNT; i++) {
+        if (snap[i] != snap[0]) torn++;
+      }
+      if (snap[0] < last) torn++;  // 不會倒退回舊的一批
+      last = snap[0];
+      reads++;
+    }
+  });
+
+  // 寫的一方（loop）：每批把所有參數設成同一個遞增的值
+  ParamUpdate batch[COUNT];
+  for (int32_t v = 2; v < 300000; v++) {
+    for (uint8_t i = 0; i < COUNT; i++) batch[i] = { i, v };
+    TEST_ASSERT_EQUAL(-1, reg.apply(batch, COUNT));
+    if (v % 1000 == 0) std::this_thread::yield();
+  }
+  done = true;
+  reader.join();
+
+  TEST_ASSERT_EQUAL(0, torn.load());
+  TEST_ASSERT_TRUE(reads.load() > 100);
+  TEST_ASSERT_EQUAL(299999, reg.get(COUNT - 1));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_apply_is_all_or_nothing);
+  RUN_TEST(test_snapshot_never_sees_a_partial_batch);
+  return UNITY_END();
+}
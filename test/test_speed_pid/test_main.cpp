@@ -0,0 +1,181 @@
+// SpeedPid 主機測試：接一個一階馬達模型（duty -> 輪速，時間常數 tau），
+// 透過和 speedTask 同一個 SpeedLoop（量測低通 + PID + 編碼器失效保護）、
+// 同樣的預設增益 / 100 Hz 週期模擬，驗證步階響應、anti-windup 與沒有編碼器時的保護。
+// 量測值跟實車一樣來自整數編碼器計數。
+#include <unity.h>
+#include <SpeedPid.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+static const int32_t MAX_DUTY = 200;
+static const int32_t MAX_SPEED_CPS = 3000;  // 空載時 MAX_DUTY 對應的輪速
+static const int32_t LOOP_HZ = 100;
+static const double DT = 1.0 / LOOP_HZ;
+static const uint32_t PERIOD_US = 1000000 / LOOP_HZ;
+
+// 一階模型：tau * dv/dt = gain * duty - v；load < 1 代表負載或電池電壓低
+struct Motor {
+  double tauS = 0.08;
+  double load = 1.0;
+  double speed = 0;     // counts/s
+  double position = 0;  // counts
+  long lastCount = 0;
+
+  // 回傳這個週期的編碼器計數
+  int32_t step(int32_t duty) {
+    double gain = load * MAX_SPEED_CPS / MAX_DUTY;
+    speed += (gain * duty - speed) * DT / tauS;
+    position += speed * DT;
+    long count = lround(floor(position));
+    int32_t delta = (int32_t)(count - lastCount);
+    lastCount = count;
+    return delta;
+  }
+};
+
+struct Trace {
+  double peak = 0;
+  double mean = 0;    // 最後 0.5 s 的平均
+  int settleTicks = -1; // 第一次進入 ±5% 的時間
+  int32_t maxDuty = 0;
+};
+
+// 和 speedTask 一樣：先量測上一個週期的計數，再算這週期的 duty
+static Trace run(SpeedLoop &loop, Motor &m, int32_t setpoint, int ticks, int32_t &delta) {
+  Trace t;
+  double sum = 0;
+  int n = 0;
+  for (int i = 0; i < ticks; i++) {
+    loop.measure(delta, PERIOD_US);
+    int32_t duty = loop.update(setpoint);
+    if (abs(duty) > t.maxDuty) t.maxDuty = abs(duty);
+    delta = m.step(duty);
+    if (setpoint >= 0 ? m.speed > t.peak : m.speed < t.peak) t.peak = m.speed;
+    if (t.settleTicks < 0 && fabs(m.speed - setpoint) <= 0.05 * abs(setpoint)) t.settleTicks = i;
+    if (i >= ticks - LOOP_HZ / 2) {
+      sum += m.speed;
+      n++;
+    }
+  }
+  t.mean = sum / n;
+  return t;
+}
+
+static SpeedLoop makeLoop() {
+  SpeedLoop loop;
+  loop.setGains(SpeedLoop::defaultGains(MAX_DUTY, MAX_SPEED_CPS));
+  loop.setOutputLimit(MAX_DUTY);
+  return loop;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_step_response_tracks_setpoint_under_load() {
+  const double loads[] = { 1.0, 0.8, 0.6 };
+  for (double load : loads) {
+    SpeedLoop loop = makeLoop();
+    Motor m;
+    m.load = load;
+    int32_t delta = 0;
+    Trace t = run(loop, m, 1500, 2 * LOOP_HZ, delta);
+    TEST_ASSERT_TRUE(t.maxDuty <= MAX_DUTY);
+    // 前饋在空載時就接近目標，負載由積分補足
+    TEST_ASSERT_TRUE(t.settleTicks >= 0 && t.settleTicks < LOOP_HZ / 2);
+    TEST_ASSERT_TRUE(t.peak < 1500 * 1.15);
+    TEST_ASSERT_TRUE(fabs(t.mean - 1500) < 1500 * 0.02);
+    TEST_ASSERT_FALSE(loop.pid().saturated());
+  }
+}
+
+void test_reverse_step_is_symmetric() {
+  SpeedLoop loop = makeLoop();
+  Motor m;
+  m.load = 0.8;
+  int32_t delta = 0;
+  Trace t = run(loop, m, -1500, 2 * LOOP_HZ, delta);
+  TEST_ASSERT_TRUE(t.settleTicks >= 0 && t.settleTicks < LOOP_HZ / 2);
+  TEST_ASSERT_TRUE(fabs(t.mean + 1500) < 1500 * 0.02);
+}
+
+void test_anti_windup_recovers_after_saturation() {
+  SpeedLoop loop = makeLoop();
+  Motor m;
+  m.load = 0.5;  // 最高只跑得到 1500 cps
+  int32_t delta = 0;
+
+  // 要求 3000 cps 兩秒：輸出飽和、誤差一直是正的
+  Trace sat = run(loop, m, 3000, 2 * LOOP_HZ, delta);
+  TEST_ASSERT_EQUAL(MAX_DUTY, sat.maxDuty);
+  TEST_ASSERT_TRUE(loop.pid().saturated());
+  TEST_ASSERT_TRUE(m.speed > 1400);
+  // 前饋已經讓輸出飽和，誤差雖然一直是正的，積分也不再累積
+  TEST_ASSERT_TRUE(loop.pid().integral() < MAX_DUTY * SpeedPid::ONE / 4);
+
+  // 目標降到 1000：飽和期間積分沒有累積，半秒內回到目標、穩態誤差 < 2%
+  Trace t = run(loop, m, 1000, 2 * LOOP_HZ, delta);
+  TEST_ASSERT_TRUE(t.settleTicks >= 0 && t.settleTicks < LOOP_HZ / 2);
+  TEST_ASSERT_TRUE(fabs(t.mean - 1000) < 1000 * 0.02);
+  TEST_ASSERT_FALSE(loop.pid().saturated());
+}
+
+void test_no_encoder_falls_back() {
+  SpeedLoop loop = makeLoop();
+  Motor m;
+  // 沒有編碼器：輪子在轉，但計數一直是 0。輕推搖桿（5% 目標）
+  const int32_t setpoint = MAX_SPEED_CPS / 20;
+  int faultTick = -1;
+  int32_t maxDuty = 0;
+  for (int i = 0; i < LOOP_HZ && faultTick < 0; i++) {
+    loop.measure(0, PERIOD_US);
+    int32_t duty = loop.update(setpoint);
+    if (duty > maxDuty) maxDuty = duty;
+    m.step(duty);
+    if (loop.encoderFault()) faultTick = i;
+  }
+  // 200 ms 內判定失效，判定前輸出還沒爬到一半
+  TEST_ASSERT_TRUE(faultTick >= 0 && faultTick < LOOP_HZ / 5);
+  TEST_ASSERT_TRUE(maxDuty < MAX_DUTY / 2);
+
+  // 鎖定：之後即使有計數也維持失效，由呼叫端走開迴路
+  loop.reset();
+  loop.measure(50, PERIOD_US);
+  loop.update(setpoint);
+  TEST_ASSERT_TRUE(loop.encoderFault());
+}
+
+void test_normal_start_and_slow_crawl_are_not_faults() {
+  SpeedLoop loop = makeLoop();
+  Motor m;
+  int32_t delta = 0;
+  // 正常起步：第一個週期還沒有計數
+  run(loop, m, 1500, LOOP_HZ, delta);
+  TEST_ASSERT_FALSE(loop.encoderFault());
+
+  // 目標 0（停車）時沒有計數不算
+  loop.reset();
+  for (int i = 0; i < LOOP_HZ; i++) {
+    loop.measure(0, PERIOD_US);
+    loop.update(0);
+  }
+  TEST_ASSERT_FALSE(loop.encoderFault());
+
+  // 極低速（30 cps）還在克服靜摩擦，每 250 ms 才一個計數：
+  // 照目標 200 ms 只該收到 6 個，不判定
+  for (int i = 0; i < 2 * LOOP_HZ; i++) {
+    loop.measure(i % 25 == 24 ? 1 : 0, PERIOD_US);
+    loop.update(30);
+  }
+  TEST_ASSERT_FALSE(loop.encoderFault());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_step_response_tracks_setpoint_under_load);
+  RUN_TEST(test_reverse_step_is_symmetric);
+  RUN_TEST(test_anti_windup_recovers_after_saturation);
+  RUN_TEST(test_no_encoder_falls_back);
+  RUN_TEST(test_normal_start_and_slow_crawl_are_not_faults);
+  return UNITY_END();
+}
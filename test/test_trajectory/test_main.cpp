@@ -0,0 +1,177 @@
+// Trajectory 主機測試：用假的 millis() 模擬錄製（搖桿 frame 只在改變時送來）
+// 與 autoTask 播放（20 ms 週期 + 抖動 / 跳過週期），播放輸出必須重現錄到的階梯，
+// 而且結束時間不受 task 延遲影響。
+#include <unity.h>
+#include <Trajectory.h>
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+static const uint32_t AUTO_PERIOD_MS = 20;
+static const int16_t MAX_VALUE = 200;  // max_duty
+
+struct Input {
+  uint32_t tMs;
+  int16_t steer;
+  int16_t throttle;
+};
+
+// 錄製時搖桿實際的值（階梯）
+static void heldAt(const std::vector<Input> &in, uint32_t tMs, int16_t &steer, int16_t &throttle) {
+  steer = 0;
+  throttle = 0;
+  for (const Input &i : in) {
+    if (i.tMs > tMs) break;
+    steer = i.steer;
+    throttle = i.throttle;
+  }
+}
+
+// 和 main.cpp 的 toggleRecording / recordFrame 一樣的錄製流程
+static void recordAll(Trajectory &traj, const std::vector<Input> &in, uint32_t endMs) {
+  traj.clear();
+  traj.append(0, 0, 0);
+  for (const Input &i : in) TEST_ASSERT_TRUE(traj.record(i.tMs, i.steer, i.throttle));
+  traj.record(endMs, 0, 0);
+  traj.append(endMs, 0, 0);
+}
+
+static std::vector<Input> randomDrive(uint32_t seed, uint32_t endMs) {
+  std::mt19937 rng(seed);
+  std::vector<Input> in;
+  uint32_t t = 100;
+  while (t < endMs - 500) {
+    in.push_back({ t, (int16_t)(rng() % 201 - 100), (int16_t)(rng() % 201 - 100) });
+    t += 20 + rng() % 1500;  // 有時連續推桿，有時握住很久不動
+  }
+  return in;
+}
+
+static uint8_t buf[Trajectory::MAX_BYTES];
+static Trajectory traj, loaded;
+
+void setUp() {}
+void tearDown() {}
+
+void test_held_stick_is_not_a_ramp() {
+  std::vector<Input> in = { { 100, 0, 80 }, { 2100, 0, 0 } };
+  recordAll(traj, in, 2500);
+
+  int16_t steer, throttle;
+  // 握住 2 秒：中間一直是 80，不是從 80 斜坡降到 0
+  for (uint32_t t = 100; t < 2100; t += 10) {
+    TEST_ASSERT_TRUE(traj.sample(t, steer, throttle));
+    TEST_ASSERT_EQUAL(80, throttle);
+  }
+  TEST_ASSERT_TRUE(traj.sample(2100, steer, throttle));
+  TEST_ASSERT_EQUAL(0, throttle);
+  TEST_ASSERT_EQUAL(2500, traj.durationMs());
+}
+
+void test_record_skips_repeats_and_merges_same_ms() {
+  traj.clear();
+  traj.append(0, 0, 0);
+  TEST_ASSERT_TRUE(traj.record(100, 10, 20));
+  uint16_t n = traj.count();
+  TEST_ASSERT_TRUE(traj.record(120, 10, 20));  // 值沒變
+  TEST_ASSERT_EQUAL(n, traj.count());
+  TEST_ASSERT_TRUE(traj.record(120, 30, 20));  // hold 在 119，新值在 120
+  TEST_ASSERT_EQUAL(n + 2, traj.count());
+  TEST_ASSERT_TRUE(traj.record(120, 40, 20));  // 同一毫秒以最新為準
+  TEST_ASSERT_EQUAL(n + 2, traj.count());
+  int16_t steer, throttle;
+  TEST_ASSERT_TRUE(traj.sample(119, steer, throttle));
+  TEST_ASSERT_EQUAL(10, steer);
+  TEST_ASSERT_TRUE(traj.sample(120, steer, throttle));
+  TEST_ASSERT_EQUAL(40, steer);
+}
+
+void test_record_refuses_when_full() {
+  traj.clear();
+  for (uint16_t i = 0; i < Trajectory::MAX_KEYFRAMES - 1; i++) traj.append(i * 10, 0, (int16_t)(i & 1));
+  // 只剩一格，改變值需要 hold + 新值兩格
+  TEST_ASSERT_FALSE(traj.record(100000, 5, 5));
+  TEST_ASSERT_EQUAL(Trajectory::MAX_KEYFRAMES - 1, traj.count());
+}
+
+void test_playback_reproduces_recording_with_jitter() {
+  const uint32_t endMs = 60000;
+  std::vector<Input> in = randomDrive(11, endMs);
+  recordAll(traj, in, endMs);
+  TEST_ASSERT_TRUE(traj.count() < Trajectory::MAX_KEYFRAMES);
+
+  // 存到 NVS 再讀回來播放
+  size_t len = traj.serializedSize();
+  memcpy(buf, traj.data(), len);
+  TEST_ASSERT_TRUE(loaded.load(buf, len, MAX_VALUE));
+
+  // autoTask：週期 20 ms，每次晚 0..15 ms，偶爾被長 task 擋住跳過 5 個週期
+  std::mt19937 rng(3);
+  uint32_t startMs = 5000, nowMs = startMs, next = startMs;
+  uint32_t ticks = 0, mismatches = 0, stoppedAtMs = 0;
+  while (true) {
+    nowMs = next + rng() % 16;
+    if (rng() % 50 == 0) nowMs += 5 * AUTO_PERIOD_MS;
+    next += AUTO_PERIOD_MS;
+    while ((int32_t)(nowMs - next) >= 0) next += AUTO_PERIOD_MS;
+
+    int16_t steer, throttle, wantSteer, wantThrottle;
+    uint32_t t = nowMs - startMs;
+    if (!loaded.sample(t, steer, throttle)) {
+      stoppedAtMs = t;
+      break;
+    }
+    ticks++;
+    heldAt(in, t, wantSteer, wantThrottle);
+    if (steer != wantSteer || throttle != wantThrottle) mismatches++;
+  }
+  TEST_ASSERT_EQUAL(0, mismatches);
+  // 用 tick 數 * 週期算時間時，延遲會讓播放拉長；用 millis() 差值則準時結束
+  TEST_ASSERT_TRUE(stoppedAtMs > endMs && stoppedAtMs <= endMs + AUTO_PERIOD_MS + 15 + 5 * AUTO_PERIOD_MS);
+  TEST_ASSERT_TRUE(ticks < endMs / AUTO_PERIOD_MS);
+}
+
+void test_load_rejects_bad_data_and_keeps_old() {
+  std::vector<Input> in = { { 100, 1, 2 } };
+  recordAll(traj, in, 1000);
+  size_t len = traj.serializedSize();
+  memcpy(buf, traj.data(), len);
+  TEST_ASSERT_TRUE(loaded.load(buf, len, MAX_VALUE));
+  uint16_t n = loaded.count();
+
+  TEST_ASSERT_FALSE(loaded.load(buf, len - 1, MAX_VALUE));
+  buf[0] ^= 1;
+  TEST_ASSERT_FALSE(loaded.load(buf, len, MAX_VALUE));
+  buf[0] ^= 1;
+  // 時間不遞增
+  Keyframe k;
+  memcpy(&k, buf + sizeof(TrajectoryHeader) + sizeof(Keyframe), sizeof(k));
+  uint32_t t = k.tMs;
+  k.tMs = 0;
+  memcpy(buf + sizeof(TrajectoryHeader) + sizeof(Keyframe), &k, sizeof(k));
+  TEST_ASSERT_FALSE(loaded.load(buf, len, MAX_VALUE));
+  // 超出 ±max_duty 的值
+  k.tMs = t;
+  k.throttle = MAX_VALUE + 1;
+  memcpy(buf + sizeof(TrajectoryHeader) + sizeof(Keyframe), &k, sizeof(k));
+  TEST_ASSERT_FALSE(loaded.load(buf, len, MAX_VALUE));
+  k.throttle = -MAX_VALUE - 1;
+  memcpy(buf + sizeof(TrajectoryHeader) + sizeof(Keyframe), &k, sizeof(k));
+  TEST_ASSERT_FALSE(loaded.load(buf, len, MAX_VALUE));
+  k.throttle = -MAX_VALUE;
+  memcpy(buf + sizeof(TrajectoryHeader) + sizeof(Keyframe), &k, sizeof(k));
+  TEST_ASSERT_TRUE(Trajectory::validate(buf, len, MAX_VALUE));
+  TEST_ASSERT_EQUAL(n, loaded.count());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_held_stick_is_not_a_ramp);
+  RUN_TEST(test_record_skips_repeats_and_merges_same_ms);
+  RUN_TEST(test_record_refuses_when_full);
+  RUN_TEST(test_playback_reproduces_recording_with_jitter);
+  RUN_TEST(test_load_rejects_bad_data_and_keeps_old);
+  return UNITY_END();
+}
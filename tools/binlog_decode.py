@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode BinLog binary records (firmware built with -DBINLOG_SERIAL_BINARY).
+
+Event names and format strings are read from src/log_events.h, so the
+decoder always matches the firmware source it sits next to.
+
+  python3 tools/binlog_decode.py capture.bin
+  python3 tools/binlog_decode.py --port /dev/ttyACM0      # needs pyserial
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = b"\xb1\x06"
+RECORD = struct.Struct("<IHBB3i")  # LogRecord: tsUs, id, level, nargs, args[3]
+LEVELS = "DIWE"
+
+DEFAULT_EVENTS = os.path.join(os.path.dirname(__file__), "..", "src", "log_events.h")
+
+
+def load_events(path):
+    src = open(path, encoding="utf-8").read()
+    events = re.findall(r'X\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', src)
+    return [(name, fmt.replace("%ld", "%d")) for name, fmt in events]
+
+
+def format_record(events, ts, ev_id, level, nargs, args):
+    lv = LEVELS[level] if level < len(LEVELS) else "?"
+    if ev_id < len(events):
+        name, fmt = events[ev_id]
+        try:
+            text = fmt % tuple(args[:fmt.count("%d")])
+        except (TypeError, ValueError):
+            text = "%s %r" % (name, args[:nargs])
+    else:
+        text = "event %d %r" % (ev_id, args[:nargs])
+    return "[%d.%03d %s] %s" % (ts // 1000000, ts // 1000 % 1000, lv, text)
+
+
+def decode(stream, events, out, follow=False):
+    # follow=True 用在 serial：read() 逾時回傳空資料不代表結束，
+    # buf 要留著，否則跨越逾時的半筆 record 會被丟掉
+    buf = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            if follow:
+                continue
+            break
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                buf = buf[-1:]  # 保留可能是 sync 前半的最後一個 byte
+                break
+            if len(buf) < i + 2 + RECORD.size:
+                buf = buf[i:]
+                break
+            ts, ev_id, level, nargs, *args = RECORD.unpack_from(buf, i + 2)
+            out.write(format_record(events, ts, ev_id, level, nargs, args) + "\n")
+            out.flush()
+            buf = buf[i + 2 + RECORD.size:]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("file", nargs="?", help="binary capture (default: stdin)")
+    ap.add_argument("--port", help="read from a serial port instead")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--events", default=DEFAULT_EVENTS, help="path to log_events.h")
+    args = ap.parse_args()
+
+    events = load_events(args.events)
+    if args.port:
+        import serial  # pyserial
+        stream = serial.Serial(args.port, args.baud, timeout=1)
+        try:
+            decode(stream, events, sys.stdout, follow=True)
+        except KeyboardInterrupt:
+            pass
+    elif args.file:
+        with open(args.file, "rb") as f:
+            decode(f, events, sys.stdout)
+    else:
+        decode(sys.stdin.buffer, events, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Flash / RAM size report per component, failing the build over budget.
+
+As a PlatformIO extra script (see platformio.ini) it adds -Wl,-Map to the
+link and checks firmware.bin / firmware.map after every build.  Budgets
+come from the env section:
+
+  custom_flash_budget = 1245184      ; bytes of firmware.bin
+  custom_ram_budget = 180000         ; static RAM (.dram0.* + .iram0.*)
+  custom_component_budgets =
+      src:120000
+      ESPAsyncWebServer:90000:4000   ; name:flash[:ram]
+
+Standalone:
+
+  python3 tools/size_budget.py .pio/build/esp32-c3/firmware.map \\
+      --bin .pio/build/esp32-c3/firmware.bin --flash-budget 1245184
+"""
+import argparse
+import collections
+import os
+import re
+import sys
+
+# 哪些 output section 佔 flash / RAM（ESP32 / C3 的 linker script 名稱）
+FLASH_PREFIXES = (".flash.", ".iram0.", ".dram0.data", ".rtc.text", ".rtc.data")
+RAM_PREFIXES = (".dram0.", ".iram0.", ".rtc.")
+NOLOAD_SUFFIXES = (".bss", ".noinit")
+
+ARCHIVE_RE = re.compile(r"(?:^|[/\\])lib([^/\\]+?)\.a\(")
+
+
+def component_of(path):
+    m = ARCHIVE_RE.search(path)
+    if m:
+        return m.group(1)
+    if "/src/" in path.replace("\\", "/"):
+        return "src"
+    return os.path.basename(path.split("(")[0]) or "other"
+
+
+def is_flash(section):
+    return section.startswith(FLASH_PREFIXES) and not section.endswith(NOLOAD_SUFFIXES)
+
+
+def is_ram(section):
+    return section.startswith(RAM_PREFIXES)
+
+
+def parse_map(path):
+    """回傳 {component: [flash, ram]}，以 input section 大小累加。"""
+    usage = collections.defaultdict(lambda: [0, 0])
+    out_section = None
+    pending = None  # 名稱太長時 address / size / 檔名會換到下一行
+    in_map = False
+
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if not in_map:
+                in_map = line.startswith("Linker script and memory map")
+                continue
+            if not line.strip():
+                continue
+            if line[0] == ".":
+                out_section = line.split()[0]
+                pending = None
+                continue
+
+            tokens = line.split()
+            if line.startswith(" .") or line.startswith(" COMMON"):
+                if len(tokens) == 1:
+                    pending = tokens[0]
+                    continue
+                tokens = tokens[1:]
+            elif pending is None or not tokens[0].startswith("0x"):
+                continue
+            pending = None
+
+            if len(tokens) < 3 or not tokens[1].startswith("0x") or out_section is None:
+                continue
+            size = int(tokens[1], 16)
+            if size == 0:
+                continue
+            comp = component_of(" ".join(tokens[2:]))
+            if is_flash(out_section):
+                usage[comp][0] += size
+            if is_ram(out_section):
+                usage[comp][1] += size
+    return usage
+
+
+def parse_component_budgets(text):
+    budgets = {}
+    for item in re.split(r"[\s,]+", text or ""):
+        if not item:
+            continue
+        parts = item.split(":")
+        flash = int(parts[1], 0) if len(parts) > 1 and parts[1] else None
+        ram = int(parts[2], 0) if len(parts) > 2 and parts[2] else None
+        budgets[parts[0]] = (flash, ram)
+    return budgets
+
+
+def check(map_path, bin_path, flash_budget, ram_budget, component_budgets, top=15):
+    usage = parse_map(map_path)
+    total_ram = sum(v[1] for v in usage.values())
+    image = os.path.getsize(bin_path) if bin_path and os.path.exists(bin_path) else None
+    errors = []
+
+    print("%-28s %10s %10s" % ("component", "flash", "ram"))
+    ranked = sorted(usage.items(), key=lambda kv: kv[1][0] + kv[1][1], reverse=True)
+    for name, (flash, ram) in ranked[:top]:
+        print("%-28s %10d %10d" % (name, flash, ram))
+    if len(ranked) > top:
+        rest = ranked[top:]
+        print("%-28s %10d %10d" % ("(%d more)" % len(rest),
+                                   sum(v[0] for _, v in rest), sum(v[1] for _, v in rest)))
+
+    def over(label, used, budget):
+        if budget is None:
+            return
+        pct = used * 100.0 / budget if budget else 0
+        print("%-28s %10d / %d (%.1f%%)" % (label, used, budget, pct))
+        if used > budget:
+            errors.append("%s: %d bytes > budget %d" % (label, used, budget))
+
+    print()
+    if image is not None:
+        over("firmware.bin", image, flash_budget)
+    over("static RAM", total_ram, ram_budget)
+    for name, (flash, ram) in sorted(component_budgets.items()):
+        used = usage.get(name, [0, 0])
+        over(name + " flash", used[0], flash)
+        over(name + " ram", used[1], ram)
+
+    for e in errors:
+        print("size budget exceeded: " + e, file=sys.stderr)
+    return not errors
+
+
+def int_or_none(text):
+    text = (text or "").strip()
+    return int(text, 0) if text else None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("map")
+    ap.add_argument("--bin")
+    ap.add_argument("--flash-budget", type=lambda s: int(s, 0))
+    ap.add_argument("--ram-budget", type=lambda s: int(s, 0))
+    ap.add_argument("--component", action="append", default=[],
+                    help="name:flash[:ram], may repeat")
+    ap.add_argument("--top", type=int, default=15)
+    args = ap.parse_args()
+    ok = check(args.map, args.bin, args.flash_budget, args.ram_budget,
+               parse_component_budgets(" ".join(args.component)), args.top)
+    sys.exit(0 if ok else 1)
+
+
+def pio_setup(env):
+    map_path = os.path.join(env.subst("$BUILD_DIR"), env.subst("${PROGNAME}.map"))
+    env.Append(LINKFLAGS=["-Wl,-Map," + map_path])
+
+    def after_build(source, target, env):
+        ok = check(map_path, str(target[0]),
+                   int_or_none(env.GetProjectOption("custom_flash_budget", "")),
+                   int_or_none(env.GetProjectOption("custom_ram_budget", "")),
+                   parse_component_budgets(env.GetProjectOption("custom_component_budgets", "")))
+        return 0 if ok else 1
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", after_build)
+
+
+try:
+    Import("env")  # noqa: F821  PlatformIO / SCons 才有
+except NameError:
+    main()
+else:
+    pio_setup(env)  # noqa: F821
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""WebSocket load generator for the car firmware (port 81).
+
+Opens N clients, lets some of them stream joystick frames at a fixed rate
+and reports accepted commands/s, command -> output latency, dropped frames
+and heap cost per connection (from /metrics).
+
+Each frame carries a "seq". The firmware echoes it in the status broadcast
+it sends once the command's output has been written to the PWM; in
+closed-loop mode that is after the next speed-loop tick. "output_rtt" is
+send -> output applied -> echo received, so it includes both network
+legs. "output_fw" is the firmware-side part alone (frame received ->
+PWM written), read from /metrics ws.output_us. A frame that is replaced by
+the next one before the speed loop runs never reaches the output and is
+counted as dropped.
+Frames are neutral (steer=0, throttle=0) unless --throttle is given:
+put the car on a stand before using it.
+
+  pip install websockets
+  python3 tools/ws_loadgen.py esp32car.local --clients 4 --drivers 1 --rate 50
+  python3 tools/ws_loadgen.py 192.168.1.50 --sweep 1,2,3,4,5 --json result.json
+
+WebSocketsServer accepts WEBSOCKETS_SERVER_CLIENT_MAX clients (5 by
+default on ESP32); extra connections show up as "connect failed".
+"""
+import argparse
+import asyncio
+import json
+import sys
+import time
+import urllib.request
+
+try:
+    import websockets
+except ImportError:
+    sys.exit("needs: pip install websockets")
+
+
+def fetch_metrics(host):
+    try:
+        with urllib.request.urlopen("http://%s/metrics" % host, timeout=3) as r:
+            return json.load(r)
+    except (OSError, ValueError):
+        return None
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+class Run:
+    def __init__(self):
+        self.pending = {}     # seq -> send time
+        self.latencies = []   # ms
+        self.sent = 0
+        self.echoed = 0
+        self.status_msgs = 0
+        self.connect_failed = 0
+        self.disconnects = 0
+
+
+async def reader(ws, run):
+    try:
+        async for msg in ws:
+            now = time.perf_counter()
+            try:
+                data = json.loads(msg)
+            except ValueError:
+                continue
+            if "motorA" not in data:
+                continue
+            run.status_msgs += 1
+            sent = run.pending.pop(data.get("seq"), None)
+            if sent is not None:
+                run.echoed += 1
+                run.latencies.append((now - sent) * 1000.0)
+    except websockets.ConnectionClosed:
+        run.disconnects += 1
+
+
+async def driver(ws, run, index, rate, duration, throttle):
+    period = 1.0 / rate
+    seq = index * 1000000 + 1
+    # 先送一個回中 frame，解除可能殘留的緊急停止鎖定
+    await ws.send(json.dumps({"steer": 0, "throttle": 0}))
+    start = time.perf_counter()
+    next_t = start
+    while time.perf_counter() - start < duration:
+        frame = {"steer": 0, "throttle": throttle, "seq": seq}
+        run.pending[seq] = time.perf_counter()
+        run.sent += 1
+        try:
+            await ws.send(json.dumps(frame))
+        except websockets.ConnectionClosed:
+            return
+        seq += 1
+        next_t += period
+        await asyncio.sleep(max(0.0, next_t - time.perf_counter()))
+    try:
+        await ws.send(json.dumps({"steer": 0, "throttle": 0}))
+    except websockets.ConnectionClosed:
+        pass
+
+
+async def run_once(args, clients):
+    run = Run()
+    before = fetch_metrics(args.host)
+
+    sockets = []
+    for _ in range(clients):
+        try:
+            ws = await asyncio.wait_for(
+                websockets.connect("ws://%s:81" % args.host, ping_interval=None), 5)
+            sockets.append(ws)
+        except (OSError, asyncio.TimeoutError, websockets.InvalidHandshake):
+            run.connect_failed += 1
+    await asyncio.sleep(1.0)  # 讓 heap 數字穩定
+    connected = fetch_metrics(args.host)
+
+    readers = [asyncio.ensure_future(reader(ws, run)) for ws in sockets]
+    drivers = [driver(ws, run, i, args.rate, args.duration, args.throttle)
+               for i, ws in enumerate(sockets[:args.drivers])]
+    t0 = time.perf_counter()
+    await asyncio.gather(*drivers)
+    await asyncio.sleep(args.grace)
+    elapsed = time.perf_counter() - t0
+
+    after = fetch_metrics(args.host)
+    for ws in sockets:
+        await ws.close()
+    for r in readers:
+        r.cancel()
+
+    result = {
+        "clients": clients,
+        "connected": len(sockets),
+        "connect_failed": run.connect_failed,
+        "drivers": min(args.drivers, len(sockets)),
+        "rate_hz": args.rate,
+        "sent": run.sent,
+        "accepted_per_s": round(run.echoed / elapsed, 1) if elapsed else 0.0,
+        "dropped": run.sent - run.echoed,
+        "output_rtt_p50_ms": round(percentile(run.latencies, 50), 2),
+        "output_rtt_p99_ms": round(percentile(run.latencies, 99), 2),
+        "output_rtt_max_ms": round(max(run.latencies), 2) if run.latencies else 0.0,
+        "status_msgs": run.status_msgs,
+        "disconnects": run.disconnects,
+    }
+    if before and connected and sockets:
+        used = before["memory"]["heap_free"] - connected["memory"]["heap_free"]
+        result["heap_per_conn"] = used // len(sockets)
+    if after:
+        result["heap_min_free"] = after["memory"]["heap_min_free"]
+        result["log_dropped"] = after.get("log_dropped")
+        result["cpu_load_permille"] = after.get("cpu_load_permille")
+        output = after.get("ws", {}).get("output_us")
+        if output:
+            # 韌體端的分布從開機累計，包含前面幾輪
+            result["output_fw_p50_ms"] = output["p50"] / 1000.0
+            result["output_fw_p99_ms"] = output["p99"] / 1000.0
+            result["output_fw_max_ms"] = output["max"] / 1000.0
+    return result
+
+
+def print_result(r):
+    print("clients=%(clients)d connected=%(connected)d drivers=%(drivers)d rate=%(rate_hz)g Hz" % r)
+    print("  accepted %(accepted_per_s).1f cmd/s, sent %(sent)d, dropped %(dropped)d" % r)
+    print("  command -> output (round trip) p50 %(output_rtt_p50_ms).2f ms, "
+          "p99 %(output_rtt_p99_ms).2f ms, max %(output_rtt_max_ms).2f ms" % r)
+    if "output_fw_p99_ms" in r:
+        print("  command -> output (firmware)   p50 %(output_fw_p50_ms).2f ms, "
+              "p99 %(output_fw_p99_ms).2f ms, max %(output_fw_max_ms).2f ms" % r)
+    extra = ["%s=%s" % (k, r[k]) for k in
+             ("connect_failed", "disconnects", "heap_per_conn", "heap_min_free",
+              "log_dropped", "cpu_load_permille") if r.get(k) is not None]
+    print("  " + " ".join(extra))
+
+
+async def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("host")
+    ap.add_argument("--clients", type=int, default=1)
+    ap.add_argument("--sweep", help="comma separated client counts, overrides --clients")
+    ap.add_argument("--drivers", type=int, default=1, help="clients that send frames")
+    ap.add_argument("--rate", type=float, default=50.0, help="frames/s per driver")
+    ap.add_argument("--duration", type=float, default=10.0, help="seconds")
+    ap.add_argument("--grace", type=float, default=1.0, help="wait for late echoes")
+    ap.add_argument("--throttle", type=int, default=0)
+    ap.add_argument("--json", help="write results to this file")
+    args = ap.parse_args()
+
+    counts = [int(c) for c in args.sweep.split(",")] if args.sweep else [args.clients]
+    results = []
+    for n in counts:
+        r = await run_once(args, n)
+        print_result(r)
+        results.append(r)
+        await asyncio.sleep(2.0)  # 等 firmware 清掉斷線的 client
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())